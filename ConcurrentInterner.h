@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Insert only interner, like StringInterner, which can be searched without
+// any lock while strings are added. Every entry also carries a Value which
+// lives as long as the interner, i.e. an atomic pointer published for
+// readers.
+//
+// Entries are never moved nor released. The open addressing table of entry
+// pointers is replaced by a twice bigger one when it is half full, old
+// tables are kept until the interner is destroyed (together they are not
+// bigger than the current one), so a reader never sees a released table.
+template <typename Value> class ConcurrentInterner {
+public:
+  using id_type = std::uint32_t;
+  static constexpr id_type npos = std::numeric_limits<id_type>::max();
+
+  struct entry {
+    entry(std::string_view text, id_type id, std::size_t hash)
+        : name(text), id(id), hash(hash) {}
+    const std::string name;
+    const id_type id;
+    const std::size_t hash;
+    Value value{};
+  };
+
+  ConcurrentInterner() { m_table = grow(nullptr); }
+  ConcurrentInterner(const ConcurrentInterner &) = delete;
+  ConcurrentInterner &operator=(const ConcurrentInterner &) = delete;
+
+  // lock free lookup, nullptr when the string was never interned
+  const entry *find(std::string_view text) const {
+    return find(m_table.load(std::memory_order_acquire), text,
+                std::hash<std::string_view>{}(text));
+  }
+  entry *find(std::string_view text) {
+    return const_cast<entry *>(std::as_const(*this).find(text));
+  }
+
+  // entry of the string, a new one with the next id is added on the first
+  // call; writers are serialised by a mutex
+  entry &intern(std::string_view text) {
+    auto hash = std::hash<std::string_view>{}(text);
+    if (auto *found =
+            find(m_table.load(std::memory_order_acquire), text, hash)) {
+      return *found;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto *current = m_table.load(std::memory_order_relaxed);
+    if (auto *found = find(current, text, hash)) {
+      return *found; // added by other writer meanwhile
+    }
+    auto &added = m_entries.emplace_back(
+        text, static_cast<id_type>(m_entries.size()), hash);
+    if (m_entries.size() * 2 > current->mask + 1) {
+      // the new table has all entries, the added one included
+      m_table.store(grow(current), std::memory_order_release);
+    } else {
+      insert(*current, added);
+    }
+    return added;
+  }
+
+  // entry of an interned id, ids are given in order from 0
+  entry &operator[](id_type id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries[id];
+  }
+  const entry &operator[](id_type id) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries[id];
+  }
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+
+private:
+  struct table {
+    explicit table(std::size_t capacity)
+        : mask(capacity - 1), slots(new std::atomic<entry *>[capacity]) {
+      for (std::size_t slot = 0; slot < capacity; ++slot) {
+        slots[slot].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+    std::size_t mask;
+    std::unique_ptr<std::atomic<entry *>[]> slots;
+  };
+
+  static entry *find(const table *where, std::string_view text,
+                     std::size_t hash) {
+    for (auto slot = hash & where->mask;; slot = (slot + 1) & where->mask) {
+      auto *candidate = where->slots[slot].load(std::memory_order_acquire);
+      if (!candidate) {
+        return nullptr;
+      }
+      if (candidate->hash == hash && candidate->name == text) {
+        return candidate;
+      }
+    }
+  }
+
+  static void insert(table &where, entry &added) {
+    auto slot = added.hash & where.mask;
+    while (where.slots[slot].load(std::memory_order_relaxed)) {
+      slot = (slot + 1) & where.mask;
+    }
+    where.slots[slot].store(&added, std::memory_order_release);
+  }
+
+  // a new table with every entry, m_mutex must be held (but in constructor)
+  table *grow(const table *current) {
+    auto capacity = current ? (current->mask + 1) * 2 : std::size_t{64};
+    auto &bigger = m_tables.emplace_back(std::make_unique<table>(capacity));
+    for (auto &existing : m_entries) {
+      insert(*bigger, existing);
+    }
+    return bigger.get();
+  }
+
+  mutable std::mutex m_mutex;
+  std::deque<entry> m_entries; // indexed by id
+  std::vector<std::unique_ptr<table>> m_tables;
+  std::atomic<table *> m_table;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Epoch based reclamation of objects which are read without any lock.
+// Readers pin the current epoch for the time they use published objects,
+// writers retire objects which they unpublished. A retired object is not
+// released until every reader which could see it is gone, then it is kept
+// for reuse by acquire(), so steady publishing does not allocate.
+//
+// Readers are counted per epoch parity in a few cache line sized slots
+// (picked by thread), so pinning is one atomic increment and no reader ever
+// waits. The epoch advances from E to E + 1 when no reader is pinned in
+// E - 1, and objects retired in E - 1 are free after that.
+//
+// Writers are not synchronised here: calls of acquire() and retire() must
+// be serialised by the caller, which already holds a lock to publish.
+template <typename T> class EpochReclaimer {
+  static constexpr std::size_t slots_count{64};
+  struct alignas(64) slot {
+    std::atomic<std::uint64_t> readers[2]{};
+  };
+
+public:
+  class guard {
+  public:
+    explicit guard(std::atomic<std::uint64_t> &readers) : m_readers(&readers) {}
+    guard(guard &&other) noexcept
+        : m_readers(std::exchange(other.m_readers, nullptr)) {}
+    guard &operator=(guard &&) = delete;
+    ~guard() {
+      if (m_readers) {
+        m_readers->fetch_sub(1, std::memory_order_release);
+      }
+    }
+
+  private:
+    std::atomic<std::uint64_t> *m_readers;
+  };
+
+  EpochReclaimer() = default;
+  EpochReclaimer(const EpochReclaimer &) = delete;
+  EpochReclaimer &operator=(const EpochReclaimer &) = delete;
+  ~EpochReclaimer() {
+    for (auto &retired : m_retired) {
+      for (auto *object : retired) {
+        delete object;
+      }
+    }
+    for (auto *object : m_free) {
+      delete object;
+    }
+  }
+
+  // published objects loaded while the guard lives stay valid
+  guard pin() const {
+    static thread_local const std::size_t index =
+        std::hash<std::thread::id>{}(std::this_thread::get_id()) % slots_count;
+    auto &slot = m_slots[index];
+    while (true) {
+      auto epoch = m_epoch.load();
+      auto &readers = slot.readers[epoch & 1];
+      readers.fetch_add(1);
+      if (m_epoch.load() == epoch) {
+        return guard{readers};
+      }
+      // the epoch moved meanwhile, count the reader in the new one
+      readers.fetch_sub(1);
+    }
+  }
+
+  // a released object or a new one, to be filled and published
+  T *acquire() {
+    if (!m_free.empty()) {
+      auto *object = m_free.back();
+      m_free.pop_back();
+      return object;
+    }
+    return new T{};
+  }
+
+  // the object is not published any more, it is released when no reader can
+  // hold it
+  void retire(T *object) {
+    if (!object) {
+      return;
+    }
+    auto epoch = m_epoch.load();
+    m_retired[epoch % 3].push_back(object);
+    if (++m_retiredSinceAdvance >= advance_every) {
+      try_advance(epoch);
+    }
+  }
+
+private:
+  // retired objects between attempts to advance the epoch
+  static constexpr std::size_t advance_every{32};
+
+  void try_advance(std::uint64_t epoch) {
+    for (const auto &slot : m_slots) {
+      if (slot.readers[(epoch + 1) & 1].load()) {
+        return; // a reader of the previous epoch is still there
+      }
+    }
+    m_epoch.store(epoch + 1);
+    m_retiredSinceAdvance = 0;
+    // nobody pinned in epoch - 1 or before is left, and readers of the later
+    // epochs started after the objects retired in epoch - 1 were unpublished
+    auto &released = m_retired[(epoch + 2) % 3];
+    m_free.insert(m_free.end(), released.begin(), released.end());
+    released.clear();
+  }
+
+  mutable slot m_slots[slots_count];
+  std::atomic<std::uint64_t> m_epoch{1};
+  std::vector<T *> m_retired[3]; // by epoch % 3
+  std::vector<T *> m_free;
+  std::size_t m_retiredSinceAdvance{0};
+};
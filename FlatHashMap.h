@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Open addressing hash map in the style of Swiss tables. Slots are split in
+// groups of 16 with one control byte per slot: empty, deleted or 7 bits of
+// the hash of the key it holds. A lookup compares the 7 bits with all 16
+// control bytes of a group at once (with SSE2 when it is there) and only
+// compares keys of the slots which matched, so it mostly touches one group
+// of control bytes and one slot. Entries live in one array, no entry
+// allocates.
+//
+// Keys and values have to be default constructible and are copied around
+// when the table grows, so a string key is best a std::string_view of a
+// string which outlives its entry. Then any string type is looked up as a
+// std::string_view, without a temporary key
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class FlatHashMap {
+public:
+  using value_type = std::pair<Key, Value>;
+
+  std::size_t size() const { return m_size; }
+  bool empty() const { return !m_size; }
+
+  // entry of the key or nullptr, it is valid until the next insert
+  value_type *find(const Key &key) {
+    if (!m_size) {
+      return nullptr;
+    }
+    auto hash = mix(Hash{}(key));
+    for (auto group = first_group(hash), step = std::size_t{0};;
+         group = (group + ++step) & group_mask()) {
+      auto *control = &m_control[group * group_width];
+      for (auto found = match(control, tag(hash)); found;
+           found &= found - 1) {
+        auto &entry = m_slots[group * group_width + lowest(found)];
+        if (KeyEqual{}(entry.first, key)) {
+          return &entry;
+        }
+      }
+      if (match(control, empty_slot)) {
+        return nullptr;
+      }
+    }
+  }
+  const value_type *find(const Key &key) const {
+    return const_cast<FlatHashMap *>(this)->find(key);
+  }
+
+  bool contains(const Key &key) const { return find(key); }
+
+  // entry of the key and true when it was added, an existing entry is kept
+  template <typename... Args>
+  std::pair<value_type *, bool> try_emplace(const Key &key, Args &&...args) {
+    if (auto *found = find(key)) {
+      return {found, false};
+    }
+    if ((m_size + m_deleted + 1) * 8 > m_slots.size() * 7) {
+      // tombstones only are dropped when the table is not full of entries
+      rehash(m_size * 16 < m_slots.size() * 7 ? m_slots.size()
+                                              : m_slots.size() * 2);
+    }
+    auto hash = mix(Hash{}(key));
+    auto index = free_slot(hash);
+    if (m_control[index] == deleted_slot) {
+      --m_deleted;
+    }
+    m_control[index] = tag(hash);
+    m_slots[index] = value_type(key, Value(std::forward<Args>(args)...));
+    ++m_size;
+    return {&m_slots[index], true};
+  }
+
+  // entry returned by find()
+  void erase(value_type *entry) {
+    auto index = static_cast<std::size_t>(entry - m_slots.data());
+    // a lookup stops at the first group with an empty slot, no key was
+    // placed behind a group which already has one
+    if (match(&m_control[index - index % group_width], empty_slot)) {
+      m_control[index] = empty_slot;
+    } else {
+      m_control[index] = deleted_slot;
+      ++m_deleted;
+    }
+    *entry = value_type{};
+    --m_size;
+  }
+
+  // returns false when the key is not there
+  bool erase(const Key &key) {
+    auto *entry = find(key);
+    if (entry) {
+      erase(entry);
+    }
+    return entry;
+  }
+
+  void clear() {
+    m_control.assign(m_control.size(), empty_slot);
+    m_slots.assign(m_slots.size(), value_type{});
+    m_size = 0;
+    m_deleted = 0;
+  }
+
+  // room for `count` entries without growing
+  void reserve(std::size_t count) {
+    auto capacity = std::size_t{group_width};
+    while (capacity * 7 < count * 8) {
+      capacity *= 2;
+    }
+    if (capacity > m_slots.size()) {
+      rehash(capacity);
+    }
+  }
+
+private:
+  static constexpr std::size_t group_width{16};
+  static constexpr std::int8_t empty_slot{-128};
+  static constexpr std::int8_t deleted_slot{-2};
+
+  // spread the hash, shards of a sharded table share its low bits
+  static std::uint64_t mix(std::uint64_t hash) {
+    hash *= std::uint64_t{0x9E3779B97F4A7C15};
+    return hash ^ hash >> 32;
+  }
+  // 7 bits kept in the control byte of a full slot
+  static std::int8_t tag(std::uint64_t hash) {
+    return static_cast<std::int8_t>(hash >> 57);
+  }
+
+  std::size_t group_mask() const {
+    return m_slots.size() / group_width - 1;
+  }
+  std::size_t first_group(std::uint64_t hash) const {
+    return static_cast<std::size_t>(hash) & group_mask();
+  }
+
+  // bit for every control byte of the group which equals `value`
+  static std::uint32_t match(const std::int8_t *control, std::int8_t value) {
+#if defined(__SSE2__)
+    auto bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(control));
+    return static_cast<std::uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(value))));
+#else
+    std::uint32_t bits{0};
+    for (std::size_t index = 0; index < group_width; ++index) {
+      bits |= std::uint32_t{control[index] == value} << index;
+    }
+    return bits;
+#endif
+  }
+  // index of the lowest set bit
+  static std::size_t lowest(std::uint32_t bits) {
+#if defined(__GNUC__)
+    return static_cast<std::size_t>(__builtin_ctz(bits));
+#else
+    std::size_t index{0};
+    for (; !(bits & 1); bits >>= 1) {
+      ++index;
+    }
+    return index;
+#endif
+  }
+
+  // first empty or deleted slot on the probe sequence of the hash
+  std::size_t free_slot(std::uint64_t hash) const {
+    for (auto group = first_group(hash), step = std::size_t{0};;
+         group = (group + ++step) & group_mask()) {
+      const auto *control = &m_control[group * group_width];
+      if (auto free = match(control, empty_slot) |
+                      match(control, deleted_slot)) {
+        return group * group_width + lowest(free);
+      }
+    }
+  }
+
+  void rehash(std::size_t capacity) {
+    auto control = std::move(m_control);
+    auto slots = std::move(m_slots);
+    m_control.assign(std::max(capacity, group_width), empty_slot);
+    m_slots.assign(m_control.size(), value_type{});
+    m_deleted = 0;
+    for (std::size_t index = 0; index < slots.size(); ++index) {
+      if (control[index] >= 0) {
+        auto hash = mix(Hash{}(slots[index].first));
+        auto free = free_slot(hash);
+        m_control[free] = tag(hash);
+        m_slots[free] = std::move(slots[index]);
+      }
+    }
+  }
+
+  // both have a multiple of group_width entries, a power of two
+  std::vector<std::int8_t> m_control;
+  std::vector<value_type> m_slots;
+  std::size_t m_size{0};
+  std::size_t m_deleted{0}; // tombstones
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read only memory mapping of a whole file. The mapping is followed by
+// `padding` readable zero bytes, so parsers which read past the end of their
+// input (like simdjson) can work on the mapped file directly, without copying
+// it. The padding is an anonymous mapping placed right after the file pages.
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    std::swap(m_mapped, other.m_mapped);
+    return *this;
+  }
+  ~MappedFile() { close(); }
+
+  // returns false when the file cannot be opened or mapped (i.e. it is a pipe)
+  bool open(const std::string &path, std::size_t padding) {
+    close();
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+      return false;
+    }
+    struct stat status {};
+    if (::fstat(descriptor, &status) || !S_ISREG(status.st_mode)) {
+      ::close(descriptor);
+      return false;
+    }
+
+    auto size = static_cast<std::size_t>(status.st_size);
+    auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    auto mapped = (size + padding + page - 1) / page * page;
+    // reserve the whole range with zero pages, then put the file over it
+    void *range = ::mmap(nullptr, mapped, PROT_READ,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (range == MAP_FAILED) {
+      ::close(descriptor);
+      return false;
+    }
+    if (size && ::mmap(range, size, PROT_READ, MAP_PRIVATE | MAP_FIXED,
+                       descriptor, 0) == MAP_FAILED) {
+      ::munmap(range, mapped);
+      ::close(descriptor);
+      return false;
+    }
+    ::close(descriptor);
+    ::madvise(range, mapped, MADV_SEQUENTIAL);
+
+    m_data = static_cast<const char *>(range);
+    m_size = size;
+    m_mapped = mapped;
+    return true;
+  }
+
+  void close() {
+    if (m_data) {
+      ::munmap(const_cast<char *>(m_data), m_mapped);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = 0;
+  }
+
+  const char *data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+  bool is_open() const { return m_data; }
+
+private:
+  const char *m_data{nullptr};
+  std::size_t m_size{0};
+  std::size_t m_mapped{0};
+};
@@ -1,19 +1,33 @@
 #pragma once
 
+#include "ConcurrentInterner.h"
+#include "EpochReclaimer.h"
+#include "FlatHashMap.h"
+#include "OrderIdCodec.h"
+#include "OrderLog.h"
+#include "SlabStore.h"
+#include "SortedChunks.h"
+#include "StringInterner.h"
+#include "WorkerPool.h"
+
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <iterator>
-#include <list>
+#include <limits>
 #include <mutex>
+#include <optional>
 #include <set>
 #include <shared_mutex>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <type_traits>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -36,6 +50,9 @@ public:
   unsigned int qty() const { return m_qty; }
 
 private:
+  // the cache reads the fields in place, the accessors return copies
+  friend class OrderCache;
+
   // use the below to hold the order data
   // do not remove the these member variables
   std::string m_orderId;    // unique order id
@@ -76,260 +93,1177 @@ public:
   virtual ~OrderCacheInterface() = default;
 };
 
+// Result of adding a single order of a batch
+enum class AddStatus : std::uint8_t { added, invalid, duplicate };
+
 class OrderCache : public OrderCacheInterface {
-  // Now it's tight coupled with Order class, in next iterration this should be
-  // extracted to define it in other place. Those types can be used among
-  // classes
-  using orderIdType = std::invoke_result_t<decltype(&Order::orderId), Order>;
-  using userType = std::invoke_result_t<decltype(&Order::user), Order>;
-  using securityIdType = std::invoke_result_t<decltype(&Order::user), Order>;
-
-  // Insertin/deletion prefered
-  using ordersList = std::list<Order>;
-  using orderIterator = ordersList::iterator;
-  using ordersIteratorsList = std::list<orderIterator>;
-  // SecurityId buckets - one to many
-  using securityIdCache =
-      std::unordered_map<securityIdType, ordersIteratorsList>;
-  // User buckets - one to many
-  using userCache = std::unordered_map<userType, ordersIteratorsList>;
-  // OrderId buckets - one to one
-  using orderIdCache = std::unordered_map<orderIdType, orderIterator>;
-
-  ordersList m_orders;
-  orderIdCache m_ordersById;
-  userCache m_ordersByUser;
-  securityIdCache m_ordersBySecurity;
-
-  const std::string buy_string{"buy"};
-  const std::string sell_string{"sell"};
-
-  std::string to_lower(std::string_view input) {
-    std::string tolower;
-    for (auto character : input) {
-      tolower.push_back(static_cast<char>(std::tolower(character)));
-    }
-    return tolower;
-  }
-
-  mutable std::shared_mutex mutex;
+  // snapshots in order files are kept apart (see OrderSnapshot.h), but they
+  // are read and written with the stores of the cache
+  friend class OrderSnapshot;
 
-public:
-  virtual ~OrderCache() = default;
+  // Securities, users and companies are interned to dense ids at ingest, the
+  // indexes and the matching work only on those ids
+  using internedId = StringInterner::id_type;
 
-  void addOrder(Order order) override {
+  // Insertin/deletion prefered. Orders live in a slab store and are addressed
+  // by handles. Every entry is also a node of two intrusive lists - orders of
+  // its user and orders of its security - so it can be unlinked from them in
+  // O(1) and none of the indexes allocates per order
+  struct orderEntry;
+  using ordersList = SlabStore<orderEntry>;
+  using orderHandle = std::uint32_t;
+  static constexpr orderHandle no_order =
+      std::numeric_limits<orderHandle>::max();
+  struct orderHook {
+    orderHandle prev{no_order};
+    orderHandle next{no_order};
+  };
+  // side is parsed once at insert, Order::side() keeps the original text
+  enum class orderSide : std::uint8_t { buy, sell };
+  // fields of an order read in place, i.e. from an order file
+  struct orderFields {
+    std::string_view orderId;
+    std::string_view securityId;
+    std::string_view side;
+    unsigned int qty;
+    std::string_view user;
+    std::string_view company;
+  };
+  struct orderEntry : Order {
+    // the order is copied or moved into the entry only
+    template <typename Source,
+              typename = std::enable_if_t<
+                  std::is_base_of_v<Order, std::decay_t<Source>>>>
+    orderEntry(Source &&order, orderSide side, internedId security,
+               internedId user, internedId company, std::uint64_t sequence)
+        : Order(std::forward<Source>(order)), sideKind(side),
+          securityKey(security), userKey(user), companyKey(company),
+          sequence(sequence) {}
+    // the strings are built in the entry, there is no temporary Order
+    orderEntry(const orderFields &fields, orderSide side, internedId security,
+               internedId user, internedId company, std::uint64_t sequence)
+        : Order({}, {}, {}, fields.qty, {}, {}), sideKind(side),
+          securityKey(security), userKey(user), companyKey(company),
+          sequence(sequence) {
+      m_orderId = fields.orderId;
+      m_securityId = fields.securityId;
+      m_side = fields.side;
+      m_user = fields.user;
+      m_company = fields.company;
+    }
+    orderSide sideKind;
+    internedId securityKey;
+    internedId userKey;
+    internedId companyKey;
+    // global insertion order, used to merge orders of all stripes
+    std::uint64_t sequence;
+    orderHook userHook;
+    orderHook securityHook;
+  };
+  struct ordersBucket {
+    orderHandle head{no_order};
+    orderHandle tail{no_order};
+  };
+  static_assert(std::is_same_v<orderHandle, ordersList::handle>);
+  // SecurityId buckets - one to many, indexed by local security key
+  using securityIdCache = std::vector<ordersBucket>;
+  // User buckets - one to many, indexed by interned user id
+  using userCache = std::vector<ordersBucket>;
+  // Per company buy and sell totals of one security. They are kept up to date
+  // by every add and cancel, so matching does not need to visit the orders
+  struct companyTotals {
+    unsigned long long buy{0};
+    unsigned long long sell{0};
+  };
+  using companyTotalsList = std::vector<std::pair<internedId, companyTotals>>;
+  // Totals of one security, kept in one array in the order the companies
+  // first traded the security, so they are published in chunks
+  struct totalsVersion;
+  struct companyTotalsCache {
+    // index in totals by interned company id, companies are never removed
+    FlatHashMap<internedId, std::uint32_t> slots;
+    companyTotalsList totals;
+    // last version published by writers, they do not load it back from the
+    // securities table
+    totalsVersion *published{nullptr};
+  };
+  // indexed by local security key
+  using totalsCache = std::vector<companyTotalsCache>;
+  // Company totals of one security as published for readers. The totals
+  // are split to chunks which are shared by consecutive versions, so a
+  // change copies the chunks it touched and the chunk pointers only. Writers
+  // publish a new version at the end of every operation which changed the
+  // totals. Once published, neither a version nor its chunks are changed by
+  // writers (readers memoise the matching size only), until the version is
+  // recycled
+  static constexpr std::size_t totals_per_chunk{8};
+  struct totalsChunk {
+    std::pair<internedId, companyTotals> totals[totals_per_chunk];
+  };
+  struct totalsVersion {
+    std::size_t size{0}; // number of totals
+    std::vector<totalsChunk *> chunks;
+    // chunks of earlier versions which this one replaced. Versions are
+    // retired in the order they were published, so they are not read any
+    // more when this version is recycled
+    std::vector<totalsChunk *> released;
+    // matching size of the totals, memoised by the first reader (the only
+    // change of a published version)
+    mutable std::atomic<std::uint64_t> matching{unknown_matching};
+  };
+  static constexpr std::uint64_t unknown_matching{
+      std::numeric_limits<std::uint64_t>::max()};
+  using publishedTotals = std::atomic<totalsVersion *>;
+  // Securities are interned to a table which is searched without any lock,
+  // its entries carry the published totals
+  using securitiesTable = ConcurrentInterner<publishedTotals>;
 
-    auto validate_order = [this](const Order &order) {
-      if (order.orderId().empty() || order.securityId().empty() ||
-          order.user().empty() || order.qty() == 0 ||
-          to_lower(order.side()).compare(buy_string) &&
-              to_lower(order.side()).compare(sell_string)) {
-        std::cerr << "Invalid data. Data not added\n";
-        return 1;
+  // The security dimension is sharded into stripes. A stripe owns orders of
+  // its securities with their buckets and totals, and has its own lock, so
+  // writes to different securities do not block each other. Security with
+  // interned id N lives in stripe N % stripes under local key N / stripes.
+  // When more stripes are needed they are always locked in ascending order
+  struct stripe {
+    mutable std::shared_mutex mutex;
+    ordersList orders;
+    userCache ordersByUser; // orders of this stripe only
+    securityIdCache ordersBySecurity;
+    // quantity index of every security (see qty_key), by local key
+    std::vector<SortedChunks<std::uint64_t>> qtyBySecurity;
+    totalsCache totalsBySecurity;
+    // indexed by local security key, slots live in the securities table
+    std::vector<publishedTotals *> published;
+    // local key and chunk of totals changed since the last publish
+    std::vector<std::pair<std::size_t, std::size_t>> changed;
+    // versions unpublished by writers of this stripe, under its exclusive
+    // lock
+    EpochReclaimer<totalsVersion> versions;
+    std::deque<totalsChunk> chunks; // all chunks ever used by the stripe
+    std::vector<totalsChunk *> freeChunks;
+    // matching queries of securities of the stripe answered by the memo
+    std::atomic<std::uint64_t> matchingHits{0};
+    std::atomic<std::uint64_t> matchingMisses{0};
+  };
+
+  struct orderLocation {
+    std::uint32_t stripe;
+    orderHandle order;
+  };
+  // OrderId buckets - one to one. Keys are views of the ids of the stored
+  // orders (slab slots never move), they are erased before their orders, so
+  // an entry allocates nothing and any id string is looked up in place
+  using orderIdCache = FlatHashMap<std::string_view, orderLocation>;
+  // Order id as the id index keeps it, by number when the codec of the
+  // cache recognises it (see OrderIdCodec.h) and by text otherwise
+  struct orderIdKey {
+    std::string_view text;
+    std::optional<std::uint64_t> number;
+  };
+  // Order ids are sharded, ids with numbers by number and the others by
+  // hash. A shard keeps numbers in a table indexed by number / shards while
+  // they are dense, and in a hash map otherwise. Lock of a shard is taken
+  // after the stripe lock and nothing else is locked while it is held
+  struct idShard {
+    std::mutex mutex;
+    std::vector<orderLocation> byNumber; // order is no_order in free slots
+    FlatHashMap<std::uint64_t, orderLocation> sparseNumbers;
+    orderIdCache ordersById;
+    std::size_t size{0};
+  };
+  // the number table may always grow to this many slots, and further while
+  // it has at most 4 slots per id of the shard
+  static constexpr std::size_t dense_ids{1024};
+
+  // Interned names are shared by all stripes. Their lock is taken last and
+  // nothing else is locked while it is held
+  struct namesTable {
+    mutable std::shared_mutex mutex;
+    StringInterner names;
+  };
+
+  // everything needed to insert an order which can be done without a stripe
+  // lock
+  struct pendingOrder {
+    orderSide side;
+    internedId security;
+    internedId user;
+    internedId company;
+    std::atomic<std::uint64_t> *userStripes;
+    publishedTotals *published;
+  };
+
+  static constexpr std::size_t max_stripes{64};
+
+  securitiesTable m_securities;
+  namesTable m_users;
+  namesTable m_companies;
+  // bit for every stripe which may hold orders of the user, indexed by
+  // interned user id and grown under the m_users lock
+  std::deque<std::atomic<std::uint64_t>> m_userStripes;
+  std::vector<stripe> m_stripes;
+  const OrderIdCodec m_idCodec;
+  std::vector<idShard> m_idShards;
+  std::atomic<std::uint64_t> m_sequence{0};
+  // Every add and cancel of an order is journaled while the lock of its id
+  // shard is held, so the journal has mutations of every id in their order
+  OrderLog *m_journal{nullptr};
+  // threads which match securities with the calling thread, they are kept
+  // between calls
+  WorkerPool m_matchers;
+
+  // Fields of an order by reference. Accessors of Order return copies, which
+  // allocate for names longer than the small string buffer
+  static const std::string &id_of(const Order &order) {
+    return order.m_orderId;
+  }
+  static std::string_view id_of(const orderFields &fields) {
+    return fields.orderId;
+  }
+  static const std::string &security_of(const Order &order) {
+    return order.m_securityId;
+  }
+  static const std::string &side_of(const Order &order) {
+    return order.m_side;
+  }
+  static const std::string &user_of(const Order &order) {
+    return order.m_user;
+  }
+  static const std::string &company_of(const Order &order) {
+    return order.m_company;
+  }
+
+  static internedId intern(namesTable &table, std::string_view name) {
+    {
+      std::shared_lock<std::shared_mutex> lock(table.mutex);
+      if (auto id = table.names.find(name); id != StringInterner::npos) {
+        return id;
       }
-      return 0;
-    };
+    }
+    std::unique_lock<std::shared_mutex> lock(table.mutex);
+    return table.names.intern(name);
+  }
+
+  static internedId find_name(const namesTable &table, std::string_view name) {
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    return table.names.find(name);
+  }
+
+  std::atomic<std::uint64_t> &user_stripes(internedId user) {
+    {
+      std::shared_lock<std::shared_mutex> lock(m_users.mutex);
+      if (user < m_userStripes.size()) {
+        return m_userStripes[user];
+      }
+    }
+    std::unique_lock<std::shared_mutex> lock(m_users.mutex);
+    while (m_userStripes.size() <= user) {
+      m_userStripes.emplace_back(0);
+    }
+    return m_userStripes[user];
+  }
+
+  std::uint32_t stripe_of(internedId security) const {
+    return static_cast<std::uint32_t>(security % m_stripes.size());
+  }
+  std::size_t local_key(internedId security) const {
+    return security / m_stripes.size();
+  }
+  orderIdKey id_key(std::string_view orderId) const {
+    return {orderId, m_idCodec.number(orderId)};
+  }
+  std::size_t id_shard_index(const orderIdKey &id) const {
+    return (id.number ? *id.number : std::hash<std::string_view>{}(id.text)) %
+           m_idShards.size();
+  }
+  idShard &id_shard(const orderIdKey &id) {
+    return m_idShards[id_shard_index(id)];
+  }
+
+  // grow text id maps of the shards for the counted text ids, so a batch
+  // does not rehash them while it is inserted
+  void reserve_text_ids(const std::vector<std::size_t> &textIds) {
+    for (std::size_t index = 0; index < m_idShards.size(); ++index) {
+      if (textIds[index]) {
+        auto &ids = m_idShards[index];
+        std::lock_guard<std::mutex> lock(ids.mutex);
+        ids.ordersById.reserve(ids.ordersById.size() + textIds[index]);
+      }
+    }
+  }
+  std::size_t number_slot(std::uint64_t number) const {
+    return static_cast<std::size_t>(number / m_idShards.size());
+  }
+
+  // location of the id in its shard or nullptr, the shard lock must be held
+  orderLocation *find_id(idShard &ids, const orderIdKey &id) const {
+    if (!id.number) {
+      auto *found = ids.ordersById.find(id.text);
+      return found ? &found->second : nullptr;
+    }
+    auto slot = number_slot(*id.number);
+    if (slot < ids.byNumber.size() && ids.byNumber[slot].order != no_order) {
+      return &ids.byNumber[slot];
+    }
+    // the number may be from the time its slot was out of the table
+    auto *found = ids.sparseNumbers.find(*id.number);
+    return found ? &found->second : nullptr;
+  }
 
-    if (validate_order(order)) {
+  // add an id which is not in its shard yet, the shard lock must be held. A
+  // text id has to be a view of the id of the stored order
+  void add_id(idShard &ids, const orderIdKey &id, orderLocation location) {
+    ++ids.size;
+    if (!id.number) {
+      ids.ordersById.try_emplace(id.text, location);
       return;
     }
+    auto slot = number_slot(*id.number);
+    if (slot >= ids.byNumber.size() &&
+        slot < std::max(dense_ids, ids.size * 4)) {
+      ids.byNumber.resize(slot + 1, orderLocation{0, no_order});
+    }
+    if (slot < ids.byNumber.size()) {
+      ids.byNumber[slot] = location;
+    } else {
+      ids.sparseNumbers.try_emplace(*id.number, location);
+    }
+  }
 
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    m_orders.emplace_back(order);
+  // remove an id found by find_id(), the shard lock must be held
+  void erase_id(idShard &ids, const orderIdKey &id) {
+    --ids.size;
+    if (!id.number) {
+      ids.ordersById.erase(id.text);
+      return;
+    }
+    auto slot = number_slot(*id.number);
+    if (slot < ids.byNumber.size() && ids.byNumber[slot].order != no_order) {
+      ids.byNumber[slot].order = no_order;
+    } else {
+      ids.sparseNumbers.erase(*id.number);
+    }
+  }
+
+  // case insensitive "buy" or "sell", compared in place without a lowered copy
+  static std::optional<orderSide> parse_side(std::string_view input) {
+    auto equals = [input](std::string_view side) {
+      return input.size() == side.size() &&
+             std::equal(input.begin(), input.end(), side.begin(),
+                        [](char character, char expected) {
+                          return std::tolower(static_cast<unsigned char>(
+                                     character)) == expected;
+                        });
+    };
+    if (equals("buy")) {
+      return orderSide::buy;
+    }
+    if (equals("sell")) {
+      return orderSide::sell;
+    }
+    return std::nullopt;
+  }
 
-    auto last_element = std::prev(m_orders.end());
+  // add (or subtract) order quantity to the totals of its company. Entries
+  // which drop to zero are kept, so steady trading does not allocate
+  void update_totals(stripe &slice, const orderEntry &order, bool add) {
+    auto localKey = local_key(order.securityKey);
+    auto &cache = slice.totalsBySecurity[localKey];
+    auto [slot, added] = cache.slots.try_emplace(
+        order.companyKey, static_cast<std::uint32_t>(cache.totals.size()));
+    if (added) {
+      cache.totals.emplace_back(order.companyKey, companyTotals{});
+    }
+    auto index = slot->second;
+    auto &totals = cache.totals[index].second;
+    auto &side = order.sideKind == orderSide::buy ? totals.buy : totals.sell;
+    add ? side += order.qty() : side -= order.qty();
+    std::pair<std::size_t, std::size_t> change{localKey,
+                                               index / totals_per_chunk};
+    if (slice.changed.empty() || slice.changed.back() != change) {
+      slice.changed.push_back(change);
+    }
+  }
 
-    auto emplace_data = [&](const Order &order, auto &&container, auto key,
-                            auto value) {
-      auto [iterator, result] = container.try_emplace(key, value);
+  // Publish totals of the securities changed by the operation, the exclusive
+  // lock of the stripe must be held. Readers which may still read the
+  // previous versions keep them alive
+  void publish_totals(stripe &slice) {
+    std::sort(slice.changed.begin(), slice.changed.end());
+    slice.changed.erase(std::unique(slice.changed.begin(), slice.changed.end()),
+                        slice.changed.end());
+    for (auto change = slice.changed.begin(); change != slice.changed.end();) {
+      auto localKey = change->first;
+      auto &cache = slice.totalsBySecurity[localKey];
+      const auto &totals = cache.totals;
+      auto *version = slice.versions.acquire();
+      // chunks released with a recycled version are not read any more
+      slice.freeChunks.insert(slice.freeChunks.end(),
+                              version->released.begin(),
+                              version->released.end());
+      version->released.clear();
+      auto *previous = std::exchange(cache.published, version);
+      version->chunks.clear();
+      if (previous) {
+        version->chunks = previous->chunks;
+      }
+      version->size = totals.size();
+      version->matching.store(unknown_matching, std::memory_order_relaxed);
+      version->chunks.resize(
+          (totals.size() + totals_per_chunk - 1) / totals_per_chunk, nullptr);
 
-      using T = std::decay_t<decltype(container)>;
-      if constexpr (std::is_same_v<T, userCache> ||
-                    std::is_same_v<T, securityIdCache>) {
-        if (!result) {
-          iterator->second.emplace_back(last_element);
+      for (; change != slice.changed.end() && change->first == localKey;
+           ++change) {
+        auto &chunk = version->chunks[change->second];
+        if (chunk) {
+          version->released.push_back(chunk);
         }
-      } else if constexpr (std::is_same_v<T, orderIdCache>) {
-        if (!result) {
-          m_orders.pop_back();
-          std::cerr << "Error while adding new order. Order exists.\n";
-          return 1;
+        if (slice.freeChunks.empty()) {
+          chunk = &slice.chunks.emplace_back();
+        } else {
+          chunk = slice.freeChunks.back();
+          slice.freeChunks.pop_back();
         }
+        auto first = change->second * totals_per_chunk;
+        std::copy(totals.begin() + first,
+                  totals.begin() +
+                      std::min(first + totals_per_chunk, totals.size()),
+                  chunk->totals);
       }
-      return 0;
-    };
+      // writers of the stripe are serialised, so `previous` is still the
+      // published version. A release store is enough to publish the new
+      // one, an exchange would be a full barrier waiting for all the stores
+      // above
+      slice.published[localKey]->store(version, std::memory_order_release);
+      slice.versions.retire(previous);
+    }
+    slice.changed.clear();
+  }
 
-    if (emplace_data(order, m_ordersById, order.orderId(), last_element)) {
-      return;
+  // append order at the end of the bucket
+  template <orderHook orderEntry::*hook>
+  static void link(ordersList &orders, ordersBucket &bucket,
+                   orderHandle order) {
+    auto &links = orders[order].*hook;
+    links.prev = bucket.tail;
+    links.next = no_order;
+    auto &last = bucket.tail == no_order ? bucket.head
+                                         : (orders[bucket.tail].*hook).next;
+    last = order;
+    bucket.tail = order;
+  }
+
+  template <orderHook orderEntry::*hook>
+  static void unlink(ordersList &orders, ordersBucket &bucket,
+                     orderHandle order) {
+    auto &links = orders[order].*hook;
+    (links.prev == no_order ? bucket.head : (orders[links.prev].*hook).next) =
+        links.next;
+    (links.next == no_order ? bucket.tail : (orders[links.next].*hook).prev) =
+        links.prev;
+  }
+
+  // key of an order in the quantity index, ordered by quantity
+  static std::uint64_t qty_key(unsigned int qty, orderHandle order) {
+    return std::uint64_t{qty} << 32 | order;
+  }
+
+  // unlink order from its buckets and the totals, and release its slot. The
+  // entry of the quantity index is left when it is already removed, the order
+  // id has to be released by the caller
+  void unlink_order(stripe &slice, orderHandle order, bool unindexQty = true) {
+    const auto &entry = slice.orders[order];
+    if (unindexQty) {
+      slice.qtyBySecurity[local_key(entry.securityKey)].erase(
+          qty_key(entry.qty(), order));
     }
-    emplace_data(order, m_ordersByUser, order.user(),
-                 ordersIteratorsList{last_element});
-    emplace_data(order, m_ordersBySecurity, order.securityId(),
-                 ordersIteratorsList{last_element});
+    unlink<&orderEntry::userHook>(slice.orders,
+                                  slice.ordersByUser[entry.userKey], order);
+    unlink<&orderEntry::securityHook>(
+        slice.orders, slice.ordersBySecurity[local_key(entry.securityKey)],
+        order);
+    update_totals(slice, entry, false);
+    slice.orders.erase(order);
   }
 
-  void cancelOrder(const std::string &orderId) override {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    try { // reconsidier using find instead catching an exception
-      auto orderIterator = m_ordersById.at(orderId);
-      auto user = orderIterator->user();
-      auto securityId = orderIterator->securityId();
-      m_ordersByUser.at(user).remove(orderIterator);
-      m_ordersBySecurity.at(securityId).remove(orderIterator);
-      m_orders.erase(orderIterator);
-      m_ordersById.erase(orderId);
-    } catch (const std::out_of_range &exception) {
-      std::cerr << "There is no entry with specified order ID";
+  // remove order from every index, lock of the stripe must be held
+  void remove_order(stripe &slice, orderHandle order,
+                    bool unindexQty = true) {
+    {
+      auto orderId = id_key(id_of(slice.orders[order]));
+      auto &ids = id_shard(orderId);
+      std::lock_guard<std::mutex> lock(ids.mutex);
+      erase_id(ids, orderId);
+      if (m_journal) {
+        m_journal->cancel(orderId.text);
+      }
     }
-  };
+    unlink_order(slice, order, unindexQty);
+  }
 
-  void cancelOrdersForUser(const std::string &user) override {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    try {
-      for (auto item : m_ordersByUser.at(user)) {
-        m_ordersBySecurity.at(item->securityId()).remove(item);
-        m_ordersById.erase(item->orderId());
-        m_orders.erase(item);
-      }
-      m_ordersByUser.erase(user);
-    } catch (const std::out_of_range &exception) {
-      std::cerr << "There is no entry with provided user";
+  // checks which do not need the lock, returns parsed side of a valid order
+  static std::optional<orderSide> validate_order(const Order &order) {
+    auto side = parse_side(side_of(order));
+    if (id_of(order).empty() || security_of(order).empty() ||
+        user_of(order).empty() || order.qty() == 0 || !side) {
+      std::cerr << "Invalid data. Data not added\n";
+      return std::nullopt;
     }
-  };
+    return side;
+  }
 
-  void cancelOrdersForSecIdWithMinimumQty(const std::string &securityId,
-                                          unsigned int minQty) override {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    std::vector<std::pair<std::string, orderIterator>> clean_this_items;
-
-    try {
-      for (const auto &item : m_ordersBySecurity.at(securityId)) {
-        if (item->qty() >= minQty) {
-          clean_this_items.push_back({item->securityId(), item});
-          m_ordersById.erase(item->orderId());
-          m_ordersByUser.at(item->user()).remove(item);
-          m_orders.erase(item);
+  std::optional<pendingOrder> prepare_order(const Order &order) {
+    auto side = validate_order(order);
+    if (!side) {
+      return std::nullopt;
+    }
+    auto user = intern(m_users, user_of(order));
+    auto &security = m_securities.intern(security_of(order));
+    return pendingOrder{*side,
+                        security.id,
+                        user,
+                        intern(m_companies, company_of(order)),
+                        &user_stripes(user),
+                        &security.value};
+  }
+
+  // Insert prepared order, the exclusive lock of its stripe must be held. An
+  // rvalue order is moved into its slot, an lvalue one is copied there, and
+  // the keys are read from the stored entry, so nothing else is copied
+  template <typename Source>
+  AddStatus insert_order(Source &&order, const pendingOrder &keys) {
+    auto orderId = id_key(id_of(order));
+    auto &ids = id_shard(orderId);
+    std::unique_lock<std::mutex> idsLock(ids.mutex);
+    auto handle = store_order(std::forward<Source>(order), keys, ids, orderId);
+    if (handle == no_order) {
+      return AddStatus::duplicate;
+    }
+    idsLock.unlock();
+    auto &slice = m_stripes[stripe_of(keys.security)];
+    const auto &entry = slice.orders[handle];
+    slice.qtyBySecurity[local_key(keys.security)].insert(
+        qty_key(entry.qty(), handle));
+    link_order(slice, handle, keys);
+    return AddStatus::added;
+  }
+
+  // Store the order in its stripe and index its id, the locks of the stripe
+  // and of the id shard must be held. Returns no_order for a duplicate id
+  template <typename Source>
+  orderHandle store_order(Source &&order, const pendingOrder &keys,
+                          idShard &ids, orderIdKey &orderId) {
+    if (find_id(ids, orderId)) {
+      std::cerr << "Error while adding new order. Order exists.\n";
+      return no_order;
+    }
+    auto stripeIndex = stripe_of(keys.security);
+    auto &slice = m_stripes[stripeIndex];
+    auto localKey = local_key(keys.security);
+    if (slice.ordersBySecurity.size() <= localKey) {
+      slice.ordersBySecurity.resize(localKey + 1);
+      slice.qtyBySecurity.resize(localKey + 1);
+      slice.totalsBySecurity.resize(localKey + 1);
+      slice.published.resize(localKey + 1);
+    }
+    slice.published[localKey] = keys.published;
+    if (slice.ordersByUser.size() <= keys.user) {
+      slice.ordersByUser.resize(keys.user + 1);
+    }
+    auto handle = slice.orders.emplace_back(
+        std::forward<Source>(order), keys.side, keys.security, keys.user,
+        keys.company, m_sequence++);
+    const auto &entry = slice.orders[handle];
+    orderId.text = id_of(entry);
+    add_id(ids, orderId, orderLocation{stripeIndex, handle});
+    if (m_journal) {
+      m_journal->add(id_of(entry), security_of(entry), side_of(entry),
+                     entry.qty(), user_of(entry), company_of(entry));
+    }
+    return handle;
+  }
+
+  // link a stored order to its buckets and add it to the totals, all but the
+  // quantity index
+  void link_order(stripe &slice, orderHandle handle,
+                  const pendingOrder &keys) {
+    link<&orderEntry::userHook>(slice.orders, slice.ordersByUser[keys.user],
+                                handle);
+    link<&orderEntry::securityHook>(
+        slice.orders, slice.ordersBySecurity[local_key(keys.security)],
+        handle);
+    update_totals(slice, slice.orders[handle], true);
+    *keys.userStripes |= std::uint64_t{1} << stripe_of(keys.security);
+  }
+
+  // Insert prepared orders to the cleared cache at once, the locks of all
+  // stripes must be held. `fields(index)` gives the orderFields of the order
+  // with keys[index], orders without keys are invalid. The id shards are
+  // locked once for all orders, and the quantity index of every security is
+  // sorted once instead of growing by every order
+  template <typename Fields>
+  void rebuild_orders(const std::vector<std::optional<pendingOrder>> &keys,
+                      Fields &&fields) {
+    std::vector<std::unique_lock<std::mutex>> idLocks;
+    for (auto &ids : m_idShards) {
+      idLocks.emplace_back(ids.mutex);
+    }
+    // quantity keys by stripe and local key
+    std::vector<std::vector<std::vector<std::uint64_t>>> qtyKeys(
+        m_stripes.size());
+    for (std::size_t index = 0; index < keys.size(); ++index) {
+      if (!keys[index]) {
+        std::cerr << "Invalid data. Data not added\n";
+        continue;
+      }
+      const auto &key = *keys[index];
+      const orderFields &order = fields(index);
+      auto orderId = id_key(order.orderId);
+      auto handle = store_order(order, key, id_shard(orderId), orderId);
+      if (handle == no_order) {
+        continue;
+      }
+      auto stripeIndex = stripe_of(key.security);
+      link_order(m_stripes[stripeIndex], handle, key);
+      auto &qtys = qtyKeys[stripeIndex];
+      auto localKey = local_key(key.security);
+      if (qtys.size() <= localKey) {
+        qtys.resize(localKey + 1);
+      }
+      qtys[localKey].push_back(qty_key(order.qty, handle));
+    }
+    for (std::size_t index = 0; index < m_stripes.size(); ++index) {
+      auto &qtys = qtyKeys[index];
+      for (std::size_t localKey = 0; localKey < qtys.size(); ++localKey) {
+        std::sort(qtys[localKey].begin(), qtys[localKey].end());
+        m_stripes[index].qtyBySecurity[localKey].assign(qtys[localKey]);
+      }
+    }
+  }
+
+  // visit orders of all stripes in insertion order, locks of all stripes must
+  // be held
+  template <typename Visit> void for_each_in_order(Visit &&visit) const {
+    std::vector<ordersList::const_iterator> positions;
+    std::size_t count{0};
+    for (const auto &slice : m_stripes) {
+      positions.push_back(slice.orders.begin());
+      count += slice.orders.size();
+    }
+
+    // stripes are merged by sequence
+    for (; count; --count) {
+      std::size_t oldest{m_stripes.size()};
+      for (std::size_t index = 0; index < m_stripes.size(); ++index) {
+        if (positions[index] != m_stripes[index].orders.end() &&
+            (oldest == m_stripes.size() ||
+             positions[index]->sequence < positions[oldest]->sequence)) {
+          oldest = index;
         }
       }
+      visit(*positions[oldest]++);
+    }
+  }
 
-      if (!minQty) {
-        m_ordersBySecurity.erase(securityId);
+  // remove all orders, locks of all stripes must be held. Interned names are
+  // kept, their ids are never released
+  void clear_orders() {
+    for (auto &slice : m_stripes) {
+      for (auto *published : slice.published) {
+        if (auto *version = published ? published->exchange(nullptr)
+                                      : nullptr) {
+          version->released.insert(version->released.end(),
+                                   version->chunks.begin(),
+                                   version->chunks.end());
+          slice.versions.retire(version);
+        }
+      }
+      slice.published.clear();
+      slice.changed.clear();
+      slice.orders.clear();
+      slice.ordersByUser.clear();
+      slice.ordersBySecurity.clear();
+      slice.qtyBySecurity.clear();
+      slice.totalsBySecurity.clear();
+    }
+    for (auto &ids : m_idShards) {
+      std::lock_guard<std::mutex> lock(ids.mutex);
+      ids.byNumber.clear();
+      ids.sparseNumbers.clear();
+      ids.ordersById.clear();
+      ids.size = 0;
+    }
+    std::shared_lock<std::shared_mutex> lock(m_users.mutex);
+    for (auto &stripes : m_userStripes) {
+      stripes = 0;
+    }
+  }
+
+  template <typename Orders>
+  std::vector<AddStatus> add_orders(Orders &&orders) {
+    std::vector<AddStatus> statuses(orders.size(), AddStatus::invalid);
+    std::vector<std::optional<pendingOrder>> keys;
+    std::vector<std::size_t> perStripe(m_stripes.size());
+    std::vector<std::size_t> textIds(m_idShards.size());
+    keys.reserve(orders.size());
+    for (const auto &order : orders) {
+      keys.push_back(prepare_order(order));
+      if (keys.back()) {
+        ++perStripe[stripe_of(keys.back()->security)];
+        if (auto id = id_key(id_of(order)); !id.number) {
+          ++textIds[id_shard_index(id)];
+        }
+      }
+    }
+
+    // all stripes of the batch are held at once, so orders are inserted in
+    // the same order as they come
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    for (std::size_t index = 0; index < m_stripes.size(); ++index) {
+      if (perStripe[index]) {
+        locks.emplace_back(m_stripes[index].mutex);
+        m_stripes[index].orders.reserve(perStripe[index]);
+      }
+    }
+    reserve_text_ids(textIds);
+    for (std::size_t i = 0; i < orders.size(); ++i) {
+      if (!keys[i]) {
+        continue;
+      }
+      if constexpr (std::is_lvalue_reference_v<Orders>) {
+        statuses[i] = insert_order(orders[i], *keys[i]);
       } else {
-        for (const auto &item : clean_this_items) {
-          m_ordersBySecurity.at(item.first).remove(item.second);
+        statuses[i] = insert_order(std::move(orders[i]), *keys[i]);
+      }
+    }
+    for (std::size_t index = 0; index < m_stripes.size(); ++index) {
+      if (perStripe[index]) {
+        publish_totals(m_stripes[index]);
+      }
+    }
+    return statuses;
+  }
+
+  // Matching size of published totals of a security of the stripe, versions
+  // of the stripe must be pinned. The message about missing sales or
+  // purchases is written only when `report` is set.
+  //
+  // Orders of a company never match each other, so every matched quantity
+  // has its buy or its sell (or both) outside of any given company c, and
+  // the matching is at most min(B, S, B + S - b_c - s_c) where B and S are
+  // all buys and sells, b_c and s_c buys and sells of c. The bound is also
+  // reached (it is the minimal cut of the flow network of companies), so the
+  // matching is computed in one pass, where only the company with the
+  // biggest b_c + s_c matters
+  unsigned int matching_size(stripe &slice, const totalsVersion *version,
+                             bool report) {
+    // a new version is published by every change of the totals, so the
+    // matching memoised in a version is up to date
+    if (version) {
+      auto matching = version->matching.load(std::memory_order_relaxed);
+      if (matching != unknown_matching) {
+        slice.matchingHits.fetch_add(1, std::memory_order_relaxed);
+        return static_cast<unsigned int>(matching);
+      }
+    }
+    slice.matchingMisses.fetch_add(1, std::memory_order_relaxed);
+
+    unsigned long long purchases{0};
+    unsigned long long sales{0};
+    unsigned long long biggestCompany{0};
+    for (std::size_t index = 0; version && index < version->size; ++index) {
+      const auto &totals = version->chunks[index / totals_per_chunk]
+                               ->totals[index % totals_per_chunk]
+                               .second;
+      purchases += totals.buy;
+      sales += totals.sell;
+      biggestCompany = std::max(biggestCompany, totals.buy + totals.sell);
+    }
+    if ((!purchases || !sales) && report) {
+      std::cerr << "No enought purchases and sales to compare\n";
+    }
+    auto matching = static_cast<unsigned int>(std::min(
+        {purchases, sales, purchases + sales - biggestCompany}));
+    if (version) {
+      version->matching.store(matching, std::memory_order_relaxed);
+    }
+    return matching;
+  }
+
+  // matching sizes of interned securities (nullptr for unknown ones), see
+  // getMatchingSizeForSecurities()
+  std::vector<unsigned int>
+  matching_sizes(const std::vector<const securitiesTable::entry *> &securities,
+                 unsigned threads) {
+    // versions are pinned before they are loaded, so they stay valid when
+    // the stripes are released
+    std::vector<EpochReclaimer<totalsVersion>::guard> guards;
+    for (auto &slice : m_stripes) {
+      guards.push_back(slice.versions.pin());
+    }
+    std::vector<const totalsVersion *> versions(securities.size());
+    {
+      std::vector<std::shared_lock<std::shared_mutex>> locks;
+      for (const auto &slice : m_stripes) {
+        locks.emplace_back(slice.mutex);
+      }
+      for (std::size_t index = 0; index < securities.size(); ++index) {
+        if (securities[index]) {
+          versions[index] = securities[index]->value.load();
         }
       }
-    } catch (const std::out_of_range &exception) {
-      std::cerr << "There is no entry with specified security ID";
     }
-  };
 
-  unsigned int
-  getMatchingSizeForSecurity(const std::string &securityId) override {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    using quantity = unsigned;
-    using company = std::string;
-    using short_order = std::pair<quantity, company>;
-    using orders = std::vector<short_order>;
-    orders sales;
-    orders purchases;
-
-    auto split_orders = [&](auto &sales, auto &purchases) {
-      // split orders to sales and purchases
-      try {
-        for (const auto &order : m_ordersBySecurity.at(securityId)) {
-          if (!to_lower(order->side()).compare(sell_string)) {
-            sales.emplace_back(order->qty(), order->company());
-          } else if (!to_lower(order->side()).compare(buy_string)) {
-            purchases.emplace_back(order->qty(), order->company());
+    // securities are taken by threads in small groups, so a few with many
+    // companies do not leave other threads idle
+    constexpr std::size_t group{16};
+    std::vector<unsigned int> sizes(securities.size());
+    std::atomic<std::size_t> next{0};
+    std::function<void()> match = [&] {
+      for (auto first = next.fetch_add(group); first < securities.size();
+           first = next.fetch_add(group)) {
+        auto last = std::min(first + group, securities.size());
+        for (auto index = first; index < last; ++index) {
+          if (securities[index]) {
+            sizes[index] =
+                matching_size(m_stripes[stripe_of(securities[index]->id)],
+                              versions[index], false);
           }
         }
-      } catch (const std::out_of_range &exception) {
-        std::cerr << "There is no entry with specified ID";
-        return 1;
       }
+    };
 
-      if (sales.empty() || purchases.empty()) {
-        std::cerr << "No enought purchases and sales to compare\n";
-        return 1;
+    if (!threads) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(std::min<std::size_t>(
+        threads, (securities.size() + group - 1) / group));
+    // the calling thread is one of the threads
+    m_matchers.run(threads ? threads - 1 : 0, match);
+    return sizes;
+  }
+
+public:
+  // Orders of all stripes in insertion order. It does not take any lock
+  class ordersView {
+    const std::vector<stripe> &m_stripes;
+
+    const orderEntry *pick(bool newest) const {
+      const orderEntry *picked{nullptr};
+      for (const auto &slice : m_stripes) {
+        if (slice.orders.empty()) {
+          continue;
+        }
+        const auto &candidate =
+            newest ? slice.orders.back() : slice.orders.front();
+        if (!picked || (candidate.sequence > picked->sequence) == newest) {
+          picked = &candidate;
+        }
       }
-      return 0;
-    };
+      return picked;
+    }
 
-    if (split_orders(sales, purchases)) {
-      return 0;
+  public:
+    explicit ordersView(const std::vector<stripe> &stripes)
+        : m_stripes(stripes) {}
+
+    std::size_t size() const {
+      std::size_t size{0};
+      for (const auto &slice : m_stripes) {
+        size += slice.orders.size();
+      }
+      return size;
     }
+    bool empty() const { return !size(); }
+    const Order &front() const { return *pick(false); }
+    const Order &back() const { return *pick(true); }
+  };
 
-    // this gather all purchases and sales from the one company
-    auto accumulate_orders = [](orders &current_order) {
-      orders temp;
-      auto item = current_order.rbegin();
-      while (item != current_order.rend()) {
-        auto position =
-            std::find_if(temp.begin(), temp.end(), [&](short_order order) {
-              return !order.second.compare(item->second);
-            });
-        if (position != std::end(temp)) {
-          position->first += item->first;
-        } else {
-          temp.emplace_back(*item);
+  // Number of stripes is limited to [1, 64]. Order ids which the codec
+  // recognises are indexed by number, by default all of them are kept as
+  // text
+  explicit OrderCache(std::size_t stripes = 16,
+                      OrderIdCodec idCodec = OrderIdCodec{})
+      : m_stripes(std::clamp<std::size_t>(stripes, 1, max_stripes)),
+        m_idCodec(std::move(idCodec)), m_idShards(m_stripes.size()) {}
+  virtual ~OrderCache() {
+    for (auto &slice : m_stripes) {
+      for (auto *published : slice.published) {
+        if (published) {
+          delete published->load();
         }
-        ++item;
-        current_order.pop_back();
       }
-      current_order = temp;
-    };
+    }
+  }
 
-    accumulate_orders(sales);
-    accumulate_orders(purchases);
+  void addOrder(Order order) override {
+    auto keys = prepare_order(order);
+    if (!keys) {
+      return;
+    }
 
-    // sort orders in the descendant way
-    std::function sort_short_orders = [](orders &orders) {
-      std::sort(orders.begin(), orders.end(),
-                [](const short_order &a, const short_order &b) {
-                  return a.first > b.first;
-                });
-    };
+    auto &slice = m_stripes[stripe_of(keys->security)];
+    std::unique_lock<std::shared_mutex> lock(slice.mutex);
+    insert_order(std::move(order), *keys);
+    publish_totals(slice);
+  }
 
-    sort_short_orders(sales);
-    sort_short_orders(purchases);
+  // Journal every following mutation (see OrderLog.h and OrderJournal.h),
+  // nullptr stops journaling. It has to be set before the cache is shared by
+  // threads
+  void setJournal(OrderLog *journal) { m_journal = journal; }
 
-    auto match_orders = [](auto &sales, auto &purchases) {
-      // this is the matching part - each order is checked
-      unsigned long accumulator{0};
-      for (auto &[buy_quantity, buy_company] : purchases) {
-        for (auto &[sell_quantity, sell_company] : sales) {
-          if (buy_company == sell_company) {
-            continue;
-          }
-          bool sell_is_bigger{sell_quantity > buy_quantity};
-          long match = sell_is_bigger ? sell_quantity - buy_quantity
-                                      : buy_quantity - sell_quantity;
-          if (match < 0) {
-            continue;
-          }
-          if (sell_is_bigger) {
-            accumulator += buy_quantity;
-            sell_quantity = match;
-            buy_quantity = 0;
-          } else {
-            accumulator += sell_quantity;
-            buy_quantity = match;
-            sell_quantity = 0;
-          }
+  // Add many orders with a single lock acquisition of every stripe they
+  // touch. Orders are validated before the locks are taken and the stores are
+  // grown once for the whole batch. Returns status of every order, in the
+  // same order as input
+  std::vector<AddStatus> addOrders(const std::vector<Order> &orders) {
+    return add_orders(orders);
+  }
+
+  // same as above, but orders are moved into the cache
+  std::vector<AddStatus> addOrders(std::vector<Order> &&orders) {
+    return add_orders(std::move(orders));
+  }
+
+  void cancelOrder(const std::string &orderId) override {
+    auto id = id_key(orderId);
+    auto &ids = id_shard(id);
+    while (true) {
+      std::uint32_t stripeIndex;
+      {
+        std::lock_guard<std::mutex> lock(ids.mutex);
+        auto *location = find_id(ids, id);
+        if (!location) {
+          std::cerr << "There is no entry with specified order ID";
+          return;
         }
+        stripeIndex = location->stripe;
       }
-      return accumulator;
-    };
 
-    return match_orders(sales, purchases);
+      // the stripe lock goes first, so the id is looked up once again
+      auto &slice = m_stripes[stripeIndex];
+      std::unique_lock<std::shared_mutex> lock(slice.mutex);
+      std::unique_lock<std::mutex> idsLock(ids.mutex);
+      auto *location = find_id(ids, id);
+      if (!location || location->stripe != stripeIndex) {
+        continue; // cancelled or added again meanwhile
+      }
+      auto order = location->order;
+      erase_id(ids, id);
+      if (m_journal) {
+        m_journal->cancel(orderId);
+      }
+      idsLock.unlock();
+      unlink_order(slice, order);
+      publish_totals(slice);
+      return;
+    }
+  };
+
+  void cancelOrdersForUser(const std::string &user) override {
+    auto userKey = find_name(m_users, user);
+    if (userKey == StringInterner::npos) {
+      std::cerr << "There is no entry with provided user";
+      return;
+    }
+    auto &userStripes = user_stripes(userKey);
+    auto stripes = userStripes.load();
+
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    for (std::size_t index = 0; index < m_stripes.size(); ++index) {
+      if (stripes & (std::uint64_t{1} << index)) {
+        locks.emplace_back(m_stripes[index].mutex);
+      }
+    }
+    for (std::size_t index = 0; index < m_stripes.size(); ++index) {
+      auto &slice = m_stripes[index];
+      if (!(stripes & (std::uint64_t{1} << index)) ||
+          slice.ordersByUser.size() <= userKey) {
+        continue;
+      }
+      auto &bucket = slice.ordersByUser[userKey];
+      while (bucket.head != no_order) {
+        remove_order(slice, bucket.head);
+      }
+      publish_totals(slice);
+    }
+    userStripes &= ~stripes;
+  };
+
+  void cancelOrdersForSecIdWithMinimumQty(const std::string &securityId,
+                                          unsigned int minQty) override {
+    const auto *security = m_securities.find(securityId);
+    if (!security) {
+      std::cerr << "There is no entry with specified security ID";
+      return;
+    }
+    auto securityKey = security->id;
+    auto &slice = m_stripes[stripe_of(securityKey)];
+    std::unique_lock<std::shared_mutex> lock(slice.mutex);
+    auto localKey = local_key(securityKey);
+    if (slice.ordersBySecurity.size() <= localKey) {
+      return;
+    }
+
+    // orders with qty >= minQty are the tail of the quantity index, so only
+    // they are visited
+    slice.qtyBySecurity[localKey].erase_from(
+        qty_key(minQty, 0), [&](std::uint64_t key) {
+          remove_order(slice, static_cast<orderHandle>(key), false);
+        });
+    publish_totals(slice);
+  };
+
+  unsigned int
+  getMatchingSizeForSecurity(const std::string &securityId) override {
+    const auto *security = m_securities.find(securityId);
+    if (!security) {
+      std::cerr << "There is no entry with specified ID";
+      return 0;
+    }
+    // only the published totals are read, without any lock, so readers
+    // neither block writers nor each other
+    auto &slice = m_stripes[stripe_of(security->id)];
+    auto guard = slice.versions.pin();
+    return matching_size(slice, security->value.load(), true);
   };
 
+  // Matching sizes of the securities, in the same order (0 for unknown
+  // securities). Totals of all of them are taken at one moment, when no
+  // writer holds a stripe, and matched by `threads` threads (all hardware
+  // threads by default)
+  std::vector<unsigned int>
+  getMatchingSizeForSecurities(const std::vector<std::string> &securityIds,
+                               unsigned threads = 0) {
+    std::vector<const securitiesTable::entry *> securities;
+    securities.reserve(securityIds.size());
+    for (const auto &securityId : securityIds) {
+      securities.push_back(m_securities.find(securityId));
+    }
+    return matching_sizes(securities, threads);
+  }
+
+  // Matching sizes of all securities ever added, ordered by security id
+  std::vector<std::pair<std::string, unsigned int>>
+  getMatchingSizeForAllSecurities(unsigned threads = 0) {
+    std::vector<const securitiesTable::entry *> securities;
+    for (std::size_t id = 0, count = m_securities.size(); id < count; ++id) {
+      securities.push_back(&m_securities[static_cast<internedId>(id)]);
+    }
+    std::sort(securities.begin(), securities.end(),
+              [](const auto *a, const auto *b) { return a->name < b->name; });
+    auto sizes = matching_sizes(securities, threads);
+
+    std::vector<std::pair<std::string, unsigned int>> result;
+    result.reserve(securities.size());
+    for (std::size_t index = 0; index < securities.size(); ++index) {
+      result.emplace_back(securities[index]->name, sizes[index]);
+    }
+    return result;
+  }
+
+  // Counters of matching queries answered by a memoised result (hits) and
+  // computed from the totals (misses)
+  struct matchingCacheStats {
+    std::uint64_t hits{0};
+    std::uint64_t misses{0};
+  };
+
+  matchingCacheStats getMatchingCacheStats() const {
+    matchingCacheStats stats;
+    for (const auto &slice : m_stripes) {
+      stats.hits += slice.matchingHits.load(std::memory_order_relaxed);
+      stats.misses += slice.matchingMisses.load(std::memory_order_relaxed);
+    }
+    return stats;
+  }
+
   std::vector<Order> getAllOrders() const override {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    return {m_orders.begin(), m_orders.end()};
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    std::size_t count{0};
+    for (const auto &slice : m_stripes) {
+      locks.emplace_back(slice.mutex);
+      count += slice.orders.size();
+    }
+
+    std::vector<Order> orders;
+    orders.reserve(count);
+    for_each_in_order(
+        [&orders](const orderEntry &order) { orders.push_back(order); });
+    return orders;
+  };
+
+  // Calls visit(const Order &) for all orders in insertion order, without
+  // copying them. Writers wait until the walk ends (see forEachOrderPage),
+  // and visit() must not call the cache
+  template <typename Visit> void forEachOrder(Visit &&visit) const {
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    for (const auto &slice : m_stripes) {
+      locks.emplace_back(slice.mutex);
+    }
+    for_each_in_order(
+        [&visit](const orderEntry &order) { visit(std::as_const(order)); });
+  }
+
+  // Position of a paged walk over orders (see forEachOrderPage), a default
+  // constructed cursor is at the beginning
+  class orderCursor {
+    friend class OrderCache;
+    std::size_t m_stripe{0};
+    orderHandle m_next{no_order}; // first order not visited yet
+    std::uint64_t m_sequence{0};  // sequence of that order
+    bool m_finished{false};
+
+  public:
+    bool finished() const { return m_finished; }
   };
 
+  // Calls visit(const Order &) for up to pageSize orders from the cursor on,
+  // and moves the cursor after them. Only one stripe is locked at a time and
+  // nothing is locked between pages, so a walk does not stall writers.
+  // Stripes are walked one after another, each in insertion order; every
+  // order which lives during the whole walk is visited exactly once, orders
+  // added or cancelled meanwhile may or may not be. A page costs O(pageSize)
+  // unless the next order of the cursor was cancelled since the previous
+  // page, then its stripe is searched from the start. Returns the number of
+  // visited orders, less than pageSize only at the end of the walk
+  template <typename Visit>
+  std::size_t forEachOrderPage(orderCursor &cursor, std::size_t pageSize,
+                               Visit &&visit) const {
+    std::size_t visited{0};
+    while (visited < pageSize && cursor.m_stripe < m_stripes.size()) {
+      const auto &slice = m_stripes[cursor.m_stripe];
+      std::shared_lock<std::shared_mutex> lock(slice.mutex);
+      auto order = slice.orders.first();
+      if (cursor.m_next != no_order) {
+        if (slice.orders.contains(cursor.m_next) &&
+            slice.orders[cursor.m_next].sequence == cursor.m_sequence) {
+          order = cursor.m_next;
+        } else {
+          // the order was cancelled, sequences grow in insertion order
+          while (order != no_order &&
+                 slice.orders[order].sequence < cursor.m_sequence) {
+            order = slice.orders.next(order);
+          }
+        }
+      }
+      for (; order != no_order && visited < pageSize;
+           order = slice.orders.next(order), ++visited) {
+        visit(static_cast<const Order &>(slice.orders[order]));
+      }
+
+      if (order == no_order) {
+        ++cursor.m_stripe;
+        cursor.m_next = no_order;
+      } else {
+        cursor.m_next = order;
+        cursor.m_sequence = slice.orders[order].sequence;
+      }
+    }
+    cursor.m_finished = cursor.m_stripe == m_stripes.size();
+    return visited;
+  }
+
   // need this accessor for unit testing
-  const ordersList &lookAtList() const { return m_orders; }
+  ordersView lookAtList() const { return ordersView{m_stripes}; }
 };
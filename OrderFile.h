@@ -0,0 +1,354 @@
+#pragma once
+
+#include "StringInterner.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Compact binary file of orders, which is loaded without any parsing.
+// All strings but order ids are interned, so a file is:
+//   header
+//   string tables: securities, users, companies, sides and order ids
+//   records, one per order, with indexes into the tables
+// A string table is the number of strings, offsets of the strings (one more
+// than strings) and the bytes of all strings. Integers are written in the
+// byte order of the writer, which is checked when the file is opened.
+// Sections start at 8 byte boundaries. The checksum covers everything after
+// the header. Snapshots keep in the header the position of the journal (see
+// OrderJournal.h) they were taken at.
+
+// 64-bit checksum of a sequence of bytes, which are mixed 8 at a time, so it
+// is cheap enough to verify every file which is loaded
+class OrderFileChecksum {
+public:
+  void update(const char *data, std::size_t size) {
+    if (!size) {
+      return; // data of an empty table may be null
+    }
+    m_length += size;
+    while (m_pending && size) {
+      m_buffer[m_pending++] = *data++;
+      --size;
+      if (m_pending == sizeof(std::uint64_t)) {
+        mix(m_buffer);
+        m_pending = 0;
+      }
+    }
+    for (; size >= sizeof(std::uint64_t); size -= sizeof(std::uint64_t)) {
+      mix(data);
+      data += sizeof(std::uint64_t);
+    }
+    std::memcpy(m_buffer, data, size);
+    m_pending = size;
+  }
+
+  std::uint64_t value() const {
+    auto copy = *this;
+    std::memset(copy.m_buffer + copy.m_pending, 0,
+                sizeof(copy.m_buffer) - copy.m_pending);
+    copy.mix(copy.m_buffer);
+    copy.m_hash ^= m_length;
+    copy.m_hash *= multiplier;
+    return copy.m_hash ^ (copy.m_hash >> 32);
+  }
+
+private:
+  static constexpr std::uint64_t multiplier{0x9E3779B97F4A7C15ull};
+
+  void mix(const char *data) {
+    std::uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    m_hash = (m_hash ^ word) * multiplier;
+    m_hash ^= m_hash >> 29;
+  }
+
+  std::uint64_t m_hash{0x243F6A8885A308D3ull};
+  std::uint64_t m_length{0};
+  char m_buffer[sizeof(std::uint64_t)]{};
+  std::size_t m_pending{0};
+};
+
+struct OrderFileFormat {
+  enum table : unsigned { securities, users, companies, sides, orderIds };
+  static constexpr unsigned tables{5};
+
+  static constexpr char magic[8]{'O', 'R', 'D', 'E', 'R', 'B', 'I', 'N'};
+  static constexpr std::uint32_t version{2};
+  static constexpr std::uint32_t byteOrder{0x01020304};
+
+  struct header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t orders;
+    std::uint64_t tables[OrderFileFormat::tables]; // offsets of the tables
+    std::uint64_t records;                         // offset of the records
+    std::uint64_t size;                            // size of the file
+    std::uint64_t journal; // journal position of a snapshot, or 0
+    std::uint64_t checksum;
+  };
+
+  struct record {
+    std::uint32_t security;
+    std::uint32_t user;
+    std::uint32_t company;
+    std::uint32_t side;
+    std::uint32_t qty;
+  };
+
+  static std::uint64_t aligned(std::uint64_t offset) {
+    return (offset + 7) / 8 * 8;
+  }
+};
+
+// Collects orders and writes them as an order file
+class OrderFileWriter {
+public:
+  void add(std::string_view orderId, std::string_view securityId,
+           std::string_view side, unsigned int qty, std::string_view user,
+           std::string_view company) {
+    using format = OrderFileFormat;
+    add(orderId,
+        {intern(format::securities, securityId), intern(format::users, user),
+         intern(format::companies, company), intern(format::sides, side), qty});
+  }
+
+  // add an order which strings are already interned
+  void add(std::string_view orderId, const OrderFileFormat::record &record) {
+    m_records.push_back(record);
+    m_orderIds.append(orderId);
+    m_orderIdOffsets.push_back(m_orderIds.size());
+  }
+
+  // index of the string in a table (but order ids), indexes are given in
+  // order from 0, so a table can be filled with ids of other interner
+  std::uint32_t intern(OrderFileFormat::table table, std::string_view text) {
+    return m_names[table].intern(text);
+  }
+
+  std::size_t size() const { return m_records.size(); }
+
+  void set_journal_position(std::uint64_t position) { m_journal = position; }
+
+  // returns false when the file cannot be written
+  bool save(const std::string &path) const {
+    using format = OrderFileFormat;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+
+    format::header header{};
+    std::memcpy(header.magic, format::magic, sizeof(header.magic));
+    header.version = format::version;
+    header.byteOrder = format::byteOrder;
+    header.orders = m_records.size();
+    header.journal = m_journal;
+
+    // the header is written again when the checksum is known
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    std::uint64_t offset{sizeof(header)};
+    OrderFileChecksum checksum;
+    auto write = [&](const void *data, std::size_t size) {
+      file.write(static_cast<const char *>(data),
+                 static_cast<std::streamsize>(size));
+      checksum.update(static_cast<const char *>(data), size);
+      offset += size;
+    };
+    auto align = [&] {
+      static constexpr char zeros[8]{};
+      write(zeros, format::aligned(offset) - offset);
+    };
+    auto write_table = [&](std::uint64_t count, const std::uint64_t *offsets,
+                           const char *bytes) {
+      write(&count, sizeof(count));
+      write(offsets, (count + 1) * sizeof(std::uint64_t));
+      write(bytes, offsets[count]);
+      align();
+    };
+
+    for (unsigned table = 0; table < format::orderIds; ++table) {
+      // interned strings are joined like the order ids
+      std::string bytes;
+      std::vector<std::uint64_t> offsets{0};
+      for (std::size_t id = 0; id < m_names[table].size(); ++id) {
+        bytes.append(m_names[table][static_cast<StringInterner::id_type>(id)]);
+        offsets.push_back(bytes.size());
+      }
+      header.tables[table] = offset;
+      write_table(m_names[table].size(), offsets.data(), bytes.data());
+    }
+    header.tables[format::orderIds] = offset;
+    write_table(m_records.size(), m_orderIdOffsets.data(), m_orderIds.data());
+    header.records = offset;
+    write(m_records.data(), m_records.size() * sizeof(format::record));
+
+    header.size = offset;
+    header.checksum = checksum.value();
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    return static_cast<bool>(file.flush());
+  }
+
+private:
+  std::array<StringInterner, OrderFileFormat::orderIds> m_names;
+  std::string m_orderIds;
+  std::vector<std::uint64_t> m_orderIdOffsets{0};
+  std::vector<OrderFileFormat::record> m_records;
+  std::uint64_t m_journal{0};
+};
+
+// Read only view of an order file in memory (i.e. a MappedFile). The whole
+// file is validated when it is opened, so strings and records can be then
+// read without any checks
+class OrderFileView {
+public:
+  using format = OrderFileFormat;
+
+  // returns false when the data is not a valid order file
+  bool open(const char *data, std::size_t size) {
+    m_data = nullptr;
+    format::header header;
+    if (size < sizeof(header)) {
+      return fail("the file is too short");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, format::magic, sizeof(header.magic))) {
+      return fail("it is not an order file");
+    }
+    if (header.byteOrder != format::byteOrder) {
+      return fail("the file was written with different byte order");
+    }
+    if (header.version != format::version) {
+      return fail("unsupported version " + std::to_string(header.version));
+    }
+    if (header.size != size) {
+      return fail("the file is truncated");
+    }
+    OrderFileChecksum checksum;
+    checksum.update(data + sizeof(header), size - sizeof(header));
+    if (checksum.value() != header.checksum) {
+      return fail("checksum mismatch");
+    }
+
+    m_data = data;
+    m_orders = header.orders;
+    m_journal = header.journal;
+    for (unsigned table = 0; table < format::tables; ++table) {
+      if (!open_table(table, header.tables[table], size)) {
+        m_data = nullptr;
+        return fail("a string table is broken");
+      }
+    }
+    m_records = header.records;
+    if (m_tables[format::orderIds].count != m_orders ||
+        m_records > size ||
+        (size - m_records) / sizeof(format::record) < m_orders) {
+      m_data = nullptr;
+      return fail("records are out of the file");
+    }
+    for (std::uint64_t index = 0; index < m_orders; ++index) {
+      auto order = record(index);
+      if (order.security >= m_tables[format::securities].count ||
+          order.user >= m_tables[format::users].count ||
+          order.company >= m_tables[format::companies].count ||
+          order.side >= m_tables[format::sides].count) {
+        m_data = nullptr;
+        return fail("a record points out of a string table");
+      }
+    }
+    return true;
+  }
+
+  bool is_open() const { return m_data; }
+
+  // number of orders
+  std::size_t size() const { return m_orders; }
+
+  std::uint64_t journal_position() const { return m_journal; }
+
+  format::record record(std::size_t index) const {
+    format::record order;
+    std::memcpy(&order, m_data + m_records + index * sizeof(order),
+                sizeof(order));
+    return order;
+  }
+
+  std::size_t table_size(format::table table) const {
+    return m_tables[table].count;
+  }
+
+  std::string_view string(format::table table, std::size_t index) const {
+    const auto &strings = m_tables[table];
+    auto begin = offset(strings, index);
+    return {m_data + strings.bytes + begin,
+            offset(strings, index + 1) - begin};
+  }
+
+  // Calls onOrder(orderId, securityId, side, qty, user, company) for every
+  // order of the file, strings are views of the file
+  template <typename OnOrder> void read(OnOrder &&onOrder) const {
+    for (std::size_t index = 0; index < m_orders; ++index) {
+      auto order = record(index);
+      onOrder(string(format::orderIds, index),
+              string(format::securities, order.security),
+              string(format::sides, order.side), order.qty,
+              string(format::users, order.user),
+              string(format::companies, order.company));
+    }
+  }
+
+private:
+  struct stringTable {
+    std::uint64_t count{0};
+    std::uint64_t offsets{0}; // offset of the string offsets
+    std::uint64_t bytes{0};   // offset of the string bytes
+  };
+
+  static bool fail(const std::string &reason) {
+    std::cerr << "Invalid order file: " << reason << '\n';
+    return false;
+  }
+
+  std::uint64_t offset(const stringTable &table, std::size_t index) const {
+    std::uint64_t value;
+    std::memcpy(&value, m_data + table.offsets + index * sizeof(value),
+                sizeof(value));
+    return value;
+  }
+
+  bool open_table(unsigned index, std::uint64_t at, std::size_t size) {
+    auto &table = m_tables[index];
+    if (at > size || size - at < sizeof(table.count)) {
+      return false;
+    }
+    std::memcpy(&table.count, m_data + at, sizeof(table.count));
+    table.offsets = at + sizeof(table.count);
+    if ((size - table.offsets) / sizeof(std::uint64_t) <= table.count) {
+      return false;
+    }
+    table.bytes = table.offsets + (table.count + 1) * sizeof(std::uint64_t);
+    std::uint64_t previous{0};
+    for (std::size_t string = 0; string <= table.count; ++string) {
+      auto next = offset(table, string);
+      if (next < previous) {
+        return false;
+      }
+      previous = next;
+    }
+    return previous <= size - table.bytes;
+  }
+
+  const char *m_data{nullptr};
+  std::uint64_t m_orders{0};
+  std::uint64_t m_records{0};
+  std::uint64_t m_journal{0};
+  stringTable m_tables[format::tables];
+};
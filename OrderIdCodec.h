@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Recognises order ids made of a fixed prefix and a decimal number, like
+// "OrdId42" (see test/data_generator.py), or plain numbers with an empty
+// prefix. Such an id is kept by its number, other ids by their text.
+//
+// Only the canonical spelling of a number is recognised (no sign, no
+// leading zeros, at most 18 digits), so every number stands for exactly one
+// id and "OrdId042" stays a text id distinct from "OrdId42". A default
+// constructed codec recognises nothing.
+class OrderIdCodec {
+public:
+  OrderIdCodec() = default;
+  explicit OrderIdCodec(std::string_view prefix)
+      : m_prefix(prefix), m_enabled(true) {}
+
+  // number of the id, nullopt when it is kept by text
+  std::optional<std::uint64_t> number(std::string_view id) const {
+    if (!m_enabled || id.size() <= m_prefix.size() ||
+        id.size() - m_prefix.size() > max_digits ||
+        id.compare(0, m_prefix.size(), m_prefix) != 0) {
+      return std::nullopt;
+    }
+    auto digits = id.substr(m_prefix.size());
+    if (digits[0] == '0' && digits.size() > 1) {
+      return std::nullopt;
+    }
+    std::uint64_t value{0};
+    for (auto digit : digits) {
+      if (digit < '0' || digit > '9') {
+        return std::nullopt;
+      }
+      value = value * 10 + static_cast<std::uint64_t>(digit - '0');
+    }
+    return value;
+  }
+
+  bool enabled() const { return m_enabled; }
+  const std::string &prefix() const { return m_prefix; }
+
+private:
+  static constexpr std::size_t max_digits{18};
+
+  std::string m_prefix;
+  bool m_enabled{false};
+};
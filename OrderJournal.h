@@ -0,0 +1,396 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "OrderFile.h"
+#include "OrderLog.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Append only journal of cache mutations, for recovery from a snapshot plus
+// the journal tail. A journal is a short header followed by records:
+//   payload size (varint), payload, checksum of the payload (4 bytes)
+// and the payload is one of:
+//   'A', qty (varint), order id, security id, side, user, company
+//   'C', order id
+// where strings are written as their size (varint) and bytes. Multi byte
+// integers are little endian, so journals do not depend on the writer.
+//
+// Records are effects, not calls: cancelling orders of a user is journaled
+// as a cancel of every removed order. With lock striping only the order of
+// mutations of the same order id is fixed, and replaying the effects in that
+// order gives the same orders, which is not true for the bulk calls.
+struct OrderJournalFormat {
+  static constexpr char magic[8]{'O', 'R', 'D', 'E', 'R', 'J', 'N', 'L'};
+  static constexpr std::uint32_t version{1};
+  static constexpr std::size_t header_size{sizeof(magic) + 4};
+  static constexpr char add{'A'};
+  static constexpr char cancel{'C'};
+
+  static void put_varint(std::string &out, std::uint64_t value) {
+    for (; value >= 0x80; value >>= 7) {
+      out.push_back(static_cast<char>(value | 0x80));
+    }
+    out.push_back(static_cast<char>(value));
+  }
+
+  static void put_u32(std::string &out, std::uint32_t value) {
+    for (int byte = 0; byte < 4; ++byte) {
+      out.push_back(static_cast<char>(value >> (8 * byte)));
+    }
+  }
+
+  static void put_string(std::string &out, std::string_view text) {
+    put_varint(out, text.size());
+    out.append(text);
+  }
+
+  static std::uint32_t checksum(const char *data, std::size_t size) {
+    OrderFileChecksum checksum;
+    checksum.update(data, size);
+    return static_cast<std::uint32_t>(checksum.value());
+  }
+};
+
+// Reads journal records from a position. Calls
+// onAdd(orderId, securityId, side, qty, user, company) and onCancel(orderId)
+// with views of the file. Reading stops at the end of the journal or at the
+// first incomplete or broken record (the tail of a crash). Returns the
+// position after the last record read, or 0 when the file is not a journal
+// or it is shorter than the position.
+class OrderJournalReader {
+public:
+  using format = OrderJournalFormat;
+
+  template <typename OnAdd, typename OnCancel>
+  static std::uint64_t read(const std::string &path, std::uint64_t from,
+                            OnAdd &&onAdd, OnCancel &&onCancel) {
+    MappedFile file;
+    if (!file.open(path, 0) || file.size() < format::header_size ||
+        std::memcmp(file.data(), format::magic, sizeof(format::magic))) {
+      return 0;
+    }
+    const auto *data = file.data();
+    std::size_t version{0};
+    if (!read_u32(data, sizeof(format::magic), file.size(), version) ||
+        version != format::version) {
+      return 0;
+    }
+
+    if (from > file.size()) {
+      return 0;
+    }
+    auto position = std::max<std::uint64_t>(from, format::header_size);
+    while (position < file.size()) {
+      std::size_t at = position;
+      std::uint64_t size{0};
+      std::size_t checksum{0};
+      if (!read_varint(data, at, file.size(), size) ||
+          file.size() - at < size ||
+          !read_u32(data, at + size, file.size(), checksum) ||
+          checksum != format::checksum(data + at, size)) {
+        break;
+      }
+      auto end = at + size;
+      if (!replay(data, at, end, onAdd, onCancel)) {
+        break;
+      }
+      position = end + 4;
+    }
+    return position;
+  }
+
+private:
+  static bool read_varint(const char *data, std::size_t &at, std::size_t end,
+                          std::uint64_t &value) {
+    value = 0;
+    for (int shift = 0; at < end && shift < 64; shift += 7) {
+      auto byte = static_cast<unsigned char>(data[at++]);
+      value |= std::uint64_t{byte & 0x7Fu} << shift;
+      if (!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static bool read_u32(const char *data, std::size_t at, std::size_t end,
+                       std::size_t &value) {
+    if (end - at < 4 || at > end) {
+      return false;
+    }
+    value = 0;
+    for (int byte = 0; byte < 4; ++byte) {
+      value |= std::size_t{static_cast<unsigned char>(data[at + byte])}
+               << (8 * byte);
+    }
+    return true;
+  }
+
+  static bool read_string(const char *data, std::size_t &at, std::size_t end,
+                          std::string_view &text) {
+    std::uint64_t size{0};
+    if (!read_varint(data, at, end, size) || end - at < size) {
+      return false;
+    }
+    text = {data + at, static_cast<std::size_t>(size)};
+    at += size;
+    return true;
+  }
+
+  template <typename OnAdd, typename OnCancel>
+  static bool replay(const char *data, std::size_t at, std::size_t end,
+                     OnAdd &onAdd, OnCancel &onCancel) {
+    if (at == end) {
+      return false;
+    }
+    auto type = data[at++];
+    std::string_view orderId;
+    if (type == format::cancel) {
+      if (!read_string(data, at, end, orderId) || at != end) {
+        return false;
+      }
+      onCancel(orderId);
+      return true;
+    }
+
+    std::uint64_t qty{0};
+    std::string_view securityId, side, user, company;
+    if (type != format::add || !read_varint(data, at, end, qty) ||
+        !read_string(data, at, end, orderId) ||
+        !read_string(data, at, end, securityId) ||
+        !read_string(data, at, end, side) ||
+        !read_string(data, at, end, user) ||
+        !read_string(data, at, end, company) || at != end) {
+      return false;
+    }
+    onAdd(orderId, securityId, side, static_cast<unsigned int>(qty), user,
+          company);
+    return true;
+  }
+};
+
+// Writer of a journal with group commit. Records are appended to a buffer,
+// which is all what the write path pays for, and a background thread writes
+// and syncs the buffer to the disk at most `window` after the first record of
+// a group was appended. sync() waits until everything appended is durable.
+// When a write fails the journal stops: a record after a torn one would be
+// lost on recovery anyway, so later records are dropped and failed() is set.
+class OrderJournal : public OrderLog {
+public:
+  using format = OrderJournalFormat;
+
+  explicit OrderJournal(
+      std::chrono::microseconds window = std::chrono::milliseconds(1))
+      : m_window(window) {}
+  OrderJournal(const OrderJournal &) = delete;
+  OrderJournal &operator=(const OrderJournal &) = delete;
+  ~OrderJournal() override { close(); }
+
+  // Opens the journal for appending, a new file gets a header. A broken tail
+  // of an existing journal (i.e. a record written partially in a crash) is
+  // cut off. Returns false when the file cannot be opened or it is not a
+  // journal
+  bool open(const std::string &path) {
+    close();
+    m_descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (m_descriptor < 0) {
+      return false;
+    }
+    auto size = ::lseek(m_descriptor, 0, SEEK_END);
+    if (size > 0) {
+      auto end = OrderJournalReader::read(
+          path, 0, [](auto...) {}, [](auto) {});
+      if (!end || (static_cast<off_t>(end) < size &&
+                   ::ftruncate(m_descriptor, static_cast<off_t>(end)))) {
+        close();
+        return false;
+      }
+      size = static_cast<off_t>(end);
+    } else {
+      std::string header(format::magic, sizeof(format::magic));
+      format::put_u32(header, format::version);
+      if (!write_all(header) || ::fdatasync(m_descriptor)) {
+        close();
+        return false;
+      }
+      size = static_cast<off_t>(header.size());
+    }
+
+    m_position = m_durable = static_cast<std::uint64_t>(size);
+    m_failed = false;
+    m_urgent = false;
+    m_stop = false;
+    m_flusher = std::thread([this] { flush_groups(); });
+    return true;
+  }
+
+  // makes everything durable and closes the file
+  void close() {
+    if (m_flusher.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+      }
+      m_wake.notify_one();
+      m_flusher.join();
+    }
+    if (m_descriptor >= 0) {
+      ::close(m_descriptor);
+      m_descriptor = -1;
+    }
+  }
+
+  bool is_open() const { return m_descriptor >= 0; }
+
+  void add(std::string_view orderId, std::string_view securityId,
+           std::string_view side, unsigned int qty, std::string_view user,
+           std::string_view company) override {
+    append([&](std::string &payload) {
+      payload.push_back(format::add);
+      format::put_varint(payload, qty);
+      for (auto text : {orderId, securityId, side, user, company}) {
+        format::put_string(payload, text);
+      }
+    });
+  }
+
+  void cancel(std::string_view orderId) override {
+    append([&](std::string &payload) {
+      payload.push_back(format::cancel);
+      format::put_string(payload, orderId);
+    });
+  }
+
+  // offset just after the last appended record
+  std::uint64_t position() const override {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_position;
+  }
+
+  // true when writing of the journal failed, records appended since then
+  // were dropped and position() stays at the end of the written records
+  bool failed() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failed;
+  }
+
+  // waits until every record appended so far is on the disk, returns false
+  // when writing of the journal failed
+  bool sync() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto target = m_position;
+    m_urgent = true;
+    m_wake.notify_one();
+    m_synced.wait(lock, [&] { return m_durable >= target || m_failed; });
+    return !m_failed;
+  }
+
+private:
+  // buffered records above this size make writers wait for the disk
+  static constexpr std::size_t max_buffered{std::size_t{64} << 20};
+
+  template <typename Encode> void append(Encode &&encode) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_descriptor < 0 || m_failed) {
+      return;
+    }
+    m_synced.wait(lock, [&] {
+      return m_buffer.size() < max_buffered || m_failed;
+    });
+    if (m_failed) {
+      return;
+    }
+    // the payload is encoded in place, after a maximal size prefix
+    auto start = m_buffer.size();
+    m_buffer.append(10, '\0');
+    encode(m_buffer);
+    auto payload = m_buffer.size() - start - 10;
+    std::string prefix;
+    format::put_varint(prefix, payload);
+    std::memmove(&m_buffer[start + prefix.size()], &m_buffer[start + 10],
+                 payload);
+    std::memcpy(&m_buffer[start], prefix.data(), prefix.size());
+    m_buffer.resize(start + prefix.size() + payload);
+    auto checksum = format::checksum(&m_buffer[start + prefix.size()], payload);
+    format::put_u32(m_buffer, checksum);
+    m_position += m_buffer.size() - start;
+    if (start == 0) {
+      m_wake.notify_one();
+    }
+  }
+
+  bool write_all(const std::string &data) {
+    for (std::size_t written = 0; written < data.size();) {
+      auto result =
+          ::write(m_descriptor, data.data() + written, data.size() - written);
+      if (result < 0) {
+        if (errno == EINTR) {
+          continue; // interrupted before anything was written
+        }
+        return false;
+      }
+      written += static_cast<std::size_t>(result);
+    }
+    return true;
+  }
+
+  // the background thread, it writes records in groups
+  void flush_groups() {
+    std::string group;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+      m_wake.wait(lock, [&] { return m_stop || !m_buffer.empty(); });
+      if (m_buffer.empty()) {
+        return; // stopped and everything is written
+      }
+      // let the group grow for the window, unless someone waits for it
+      m_wake.wait_for(lock, m_window, [&] { return m_stop || m_urgent; });
+      m_urgent = false;
+      group.swap(m_buffer);
+      auto position = m_position;
+      lock.unlock();
+
+      auto written = write_all(group) && !::fdatasync(m_descriptor);
+      group.clear();
+      lock.lock();
+      if (!written) {
+        // the records written so far are all the journal has
+        m_failed = true;
+        m_position = m_durable;
+        m_buffer.clear();
+        m_synced.notify_all();
+        std::cerr << "Failed to write the journal, it is stopped\n";
+        return;
+      }
+      m_durable = position;
+      m_synced.notify_all();
+    }
+  }
+
+  std::chrono::microseconds m_window;
+  int m_descriptor{-1};
+  std::thread m_flusher;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wake;   // for the flusher
+  std::condition_variable m_synced; // for threads waiting for the disk
+  std::string m_buffer;             // records not written yet
+  std::uint64_t m_position{0};      // end of the appended records
+  std::uint64_t m_durable{0};       // end of the synced records
+  bool m_urgent{false};
+  bool m_stop{false};
+  bool m_failed{false};
+};
@@ -0,0 +1,428 @@
+#pragma once
+
+#include "OrderCache.h"
+#include "lib/simdjson.h"
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// How records are laid out in the input
+enum class JsonLayout {
+  array, // a single JSON array of records
+  lines  // one record per line (NDJSON), the input can grow while it is read
+};
+
+// Finds ends of the records of a JSON array of objects, or of objects written
+// one per line. Input is scanned in pieces, the state is kept between calls,
+// and it is never modified, so it can be a read only mapping of a file. A
+// piece of complete records is a valid stream of comma separated documents
+// for simdjson iterate_many.
+class RecordSplitter {
+public:
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  explicit RecordSplitter(JsonLayout layout = JsonLayout::array)
+      : m_recordDepth(layout == JsonLayout::array ? 1 : 0) {}
+
+  // Scans data[from, to) and returns the offset just after the last record
+  // which ends in this range, or npos when none does
+  std::size_t scan(const char *data, std::size_t from, std::size_t to) {
+    std::size_t last{npos};
+    for (auto position = from; position < to && !m_failed; ++position) {
+      auto character = data[position];
+      if (m_inString) {
+        if (m_escaped) {
+          m_escaped = false;
+        } else if (character == '\\') {
+          m_escaped = true;
+        } else if (character == '"') {
+          m_inString = false;
+        }
+        continue;
+      }
+
+      if (m_depth == m_recordDepth) {
+        // between the records, every record has to be an object
+        if (character == '{') {
+          ++m_depth;
+        } else if (m_recordDepth && character == ']') {
+          m_depth = 0;
+          m_finished = true;
+        } else if ((!m_recordDepth || character != ',') &&
+                   !is_space(character)) {
+          m_failed = true;
+        }
+      } else if (m_depth == 0) {
+        // outside of the array only white spaces are allowed
+        if (!m_finished && character == '[') {
+          m_depth = m_recordDepth;
+        } else if (!is_space(character)) {
+          m_failed = true;
+        }
+      } else if (character == '"') {
+        m_inString = true;
+      } else if (character == '[' || character == '{') {
+        ++m_depth;
+      } else if ((character == ']' || character == '}') &&
+                 --m_depth == m_recordDepth) {
+        last = position + 1;
+      }
+    }
+    return last;
+  }
+
+  // true when the whole array was seen, or no line record is cut short
+  bool finished() const {
+    return !m_failed && (m_recordDepth ? m_finished : m_depth == 0);
+  }
+  // true when the input is not an array of objects
+  bool failed() const { return m_failed; }
+
+  static bool is_space(char character) {
+    return character == ' ' || character == '\n' || character == '\r' ||
+           character == '\t';
+  }
+
+private:
+  int m_recordDepth; // depth between the records
+  int m_depth{0};
+  bool m_inString{false};
+  bool m_escaped{false};
+  bool m_finished{false};
+  bool m_failed{false};
+};
+
+// Streams orders from a JSON array of objects with OrdId, SecId,
+// TransactionType, Amount, User and Company fields (the layout written by
+// test/data_generator.py), or from the same objects written one per line.
+// Input is read in chunks and every chunk of complete records is parsed with
+// the simdjson On-Demand API, so memory used by the loader is bounded by the
+// chunk size, not by the input size. Files can be also parsed in place from
+// a MappedFile.
+class JsonOrderReader {
+public:
+  explicit JsonOrderReader(JsonLayout layout = JsonLayout::array,
+                           std::size_t chunkSize = std::size_t{4} << 20)
+      : m_layout(layout), m_capacity(chunkSize) {}
+
+  // calls onOrder(Order &&) for every record of the input stream
+  template <typename OnOrder>
+  simdjson::error_code read(std::istream &input, OnOrder &&onOrder) {
+    return follow(input, onOrder, [] { return false; });
+  }
+
+  // Like read(), but the end of the input is not the end of the records:
+  // onIdle() is called whenever there is no more data, and reading goes on
+  // until it returns false. This tails a file which is still written, orders
+  // are passed to onOrder as soon as their records are complete
+  template <typename OnOrder, typename OnIdle>
+  simdjson::error_code follow(std::istream &input, OnOrder &&onOrder,
+                              OnIdle &&onIdle) {
+    auto buffer = allocate(m_capacity);
+    std::size_t filled{0}; // bytes in the buffer
+    RecordSplitter splitter{m_layout};
+
+    while (true) {
+      if (filled == m_capacity) {
+        // a single record does not fit, make the buffer bigger
+        auto bigger = allocate(m_capacity * 2);
+        std::memcpy(bigger.get(), buffer.get(), filled);
+        buffer = std::move(bigger);
+        m_capacity *= 2;
+      }
+      input.read(buffer.get() + filled,
+                 static_cast<std::streamsize>(m_capacity - filled));
+      auto read = static_cast<std::size_t>(input.gcount());
+      auto complete = splitter.scan(buffer.get(), filled, filled + read);
+      filled += read;
+      if (splitter.failed()) {
+        return simdjson::INCORRECT_TYPE;
+      }
+
+      if (complete != RecordSplitter::npos) {
+        if (auto error = parse(buffer.get(), complete, onOrder)) {
+          return error;
+        }
+        std::memmove(buffer.get(), buffer.get() + complete, filled - complete);
+        filled -= complete;
+      }
+      if (!read) {
+        if (m_layout == JsonLayout::array && splitter.finished()) {
+          break; // nothing can follow the end of the array
+        }
+        if (!onIdle()) {
+          break;
+        }
+        input.clear(); // forget the end of file, the file may have grown
+      }
+    }
+    return splitter.finished() ? simdjson::SUCCESS
+                               : simdjson::INCOMPLETE_ARRAY_OR_OBJECT;
+  }
+
+  // Calls onOrder(Order &&) for every record of the input in memory, which
+  // has to be readable up to size + SIMDJSON_PADDING (i.e. a MappedFile).
+  // The input is parsed in place, chunk by chunk, without copying it
+  template <typename OnOrder>
+  simdjson::error_code read(const char *data, std::size_t size,
+                            OnOrder &&onOrder) {
+    RecordSplitter splitter{m_layout};
+    std::size_t begin{0}; // first byte not parsed yet
+    for (std::size_t scanned = 0; scanned < size;) {
+      auto to = std::min(size, scanned + m_capacity);
+      auto complete = splitter.scan(data, scanned, to);
+      scanned = to;
+      if (splitter.failed()) {
+        return simdjson::INCORRECT_TYPE;
+      }
+      if (complete != RecordSplitter::npos) {
+        if (auto error = parse(data + begin, complete - begin, onOrder)) {
+          return error;
+        }
+        begin = complete;
+      }
+    }
+    return splitter.finished() ? simdjson::SUCCESS
+                               : simdjson::INCOMPLETE_ARRAY_OR_OBJECT;
+  }
+
+  // Parse complete records, as found by RecordSplitter, data must be
+  // readable up to size + SIMDJSON_PADDING
+  template <typename OnOrder>
+  simdjson::error_code parse(const char *data, std::size_t size,
+                             OnOrder &&onOrder) {
+    // skip the array opening and separators left from previous records
+    while (size && (RecordSplitter::is_space(*data) || *data == ',' ||
+                    *data == '[')) {
+      ++data;
+      --size;
+    }
+    simdjson::ondemand::document_stream documents;
+    auto batchSize = std::max(size, simdjson::dom::MINIMAL_BATCH_SIZE);
+    auto error =
+        m_parser.iterate_many(data, size, batchSize, true).get(documents);
+    if (error) {
+      return error;
+    }
+
+    for (auto document : documents) {
+      simdjson::ondemand::object record;
+      if ((error = document.get_object().get(record))) {
+        return error;
+      }
+      // fields are read in the order they are written, which is the fast
+      // path of On-Demand lookups
+      std::string_view orderId, securityId, side, user, company;
+      std::uint64_t amount{0};
+      if ((error = record["OrdId"].get_string().get(orderId)) ||
+          (error = record["SecId"].get_string().get(securityId)) ||
+          (error = record["TransactionType"].get_string().get(side)) ||
+          (error = read_amount(record, amount)) ||
+          (error = record["User"].get_string().get(user)) ||
+          (error = record["Company"].get_string().get(company))) {
+        return error;
+      }
+      onOrder(Order{std::string(orderId), std::string(securityId),
+                    std::string(side), static_cast<unsigned>(amount),
+                    std::string(user), std::string(company)});
+    }
+    return simdjson::SUCCESS;
+  }
+
+private:
+  // Amount is written as a string, to handle large numbers, plain numbers are
+  // accepted as well
+  static simdjson::error_code read_amount(simdjson::ondemand::object &record,
+                                          std::uint64_t &amount) {
+    simdjson::ondemand::value field;
+    simdjson::ondemand::json_type type;
+    if (auto error = record["Amount"].get(field)) {
+      return error;
+    }
+    if (auto error = field.type().get(type)) {
+      return error;
+    }
+    if (type == simdjson::ondemand::json_type::number) {
+      return field.get_uint64().get(amount);
+    }
+
+    std::string_view text;
+    if (auto error = field.get_string().get(text)) {
+      return error;
+    }
+    auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), amount);
+    if (error != std::errc{} || end != text.data() + text.size()) {
+      return simdjson::NUMBER_ERROR;
+    }
+    return simdjson::SUCCESS;
+  }
+
+  static std::unique_ptr<char[]> allocate(std::size_t size) {
+    return std::unique_ptr<char[]>(
+        new char[size + simdjson::SIMDJSON_PADDING]);
+  }
+
+  JsonLayout m_layout;
+  std::size_t m_capacity;
+  simdjson::ondemand::parser m_parser;
+};
+
+// Pipelined loader of JSON records in memory (i.e. a MappedFile). The calling
+// thread splits the input into chunks of complete records, worker threads
+// parse the chunks into batches of orders, and a single inserter thread
+// passes the batches to onBatch(std::vector<Order> &&) in input order, so
+// duplicated order ids are resolved the same way as by a sequential load.
+// The number of chunks in flight is bounded, so memory does not depend on
+// the input size.
+class ParallelOrderLoader {
+public:
+  explicit ParallelOrderLoader(
+      unsigned workers = std::max(1u, std::thread::hardware_concurrency()),
+      JsonLayout layout = JsonLayout::array,
+      std::size_t chunkSize = std::size_t{1} << 20)
+      : m_workers(std::max(1u, workers)), m_layout(layout),
+        m_chunkSize(chunkSize) {}
+
+  template <typename OnBatch>
+  simdjson::error_code read(const char *data, std::size_t size,
+                            OnBatch &&onBatch) {
+    struct chunk {
+      std::size_t index;
+      const char *data;
+      std::size_t size;
+    };
+    std::mutex mutex;
+    std::condition_variable chunkReady;  // for workers
+    std::condition_variable batchReady;  // for the inserter
+    std::condition_variable spaceReady;  // for the splitter
+    std::deque<chunk> chunks;
+    std::map<std::size_t, std::vector<Order>> batches;
+    std::size_t inFlight{0};
+    std::size_t chunkCount{0};
+    bool splitDone{false};
+    bool stop{false};
+    simdjson::error_code error{simdjson::SUCCESS};
+    auto fail = [&](simdjson::error_code failure) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error) {
+        error = failure;
+      }
+      stop = true;
+      chunkReady.notify_all();
+      batchReady.notify_all();
+      spaceReady.notify_all();
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned worker = 0; worker < m_workers; ++worker) {
+      workers.emplace_back([&] {
+        JsonOrderReader reader{m_layout};
+        while (true) {
+          std::unique_lock<std::mutex> lock(mutex);
+          chunkReady.wait(lock,
+                          [&] { return stop || splitDone || !chunks.empty(); });
+          if (stop || chunks.empty()) {
+            return;
+          }
+          auto next = chunks.front();
+          chunks.pop_front();
+          lock.unlock();
+
+          std::vector<Order> batch;
+          if (auto failure = reader.parse(next.data, next.size,
+                                          [&batch](Order &&order) {
+                                            batch.push_back(std::move(order));
+                                          })) {
+            fail(failure);
+            return;
+          }
+          lock.lock();
+          batches.emplace(next.index, std::move(batch));
+          batchReady.notify_all();
+        }
+      });
+    }
+
+    std::thread inserter([&] {
+      for (std::size_t next = 0;; ++next) {
+        std::unique_lock<std::mutex> lock(mutex);
+        batchReady.wait(lock, [&] {
+          return stop || batches.count(next) ||
+                 (splitDone && next == chunkCount);
+        });
+        if (stop || !batches.count(next)) {
+          return;
+        }
+        auto batch = std::move(batches.at(next));
+        batches.erase(next);
+        lock.unlock();
+
+        onBatch(std::move(batch));
+        lock.lock();
+        --inFlight;
+        spaceReady.notify_one();
+      }
+    });
+
+    // the splitter, it runs in the calling thread
+    RecordSplitter splitter{m_layout};
+    std::size_t begin{0};
+    for (std::size_t scanned = 0; scanned < size;) {
+      auto to = std::min(size, scanned + m_chunkSize);
+      auto complete = splitter.scan(data, scanned, to);
+      scanned = to;
+      if (splitter.failed()) {
+        fail(simdjson::INCORRECT_TYPE);
+        break;
+      }
+      if (complete == RecordSplitter::npos) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex);
+      spaceReady.wait(lock,
+                      [&] { return stop || inFlight < 2 * m_workers + 2; });
+      if (stop) {
+        break;
+      }
+      ++inFlight;
+      chunks.push_back({chunkCount++, data + begin, complete - begin});
+      chunkReady.notify_one();
+      begin = complete;
+    }
+    if (!splitter.failed() && !splitter.finished()) {
+      fail(simdjson::INCOMPLETE_ARRAY_OR_OBJECT);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      splitDone = true;
+      chunkReady.notify_all();
+      batchReady.notify_all();
+    }
+
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    inserter.join();
+    return error;
+  }
+
+private:
+  unsigned m_workers;
+  JsonLayout m_layout;
+  std::size_t m_chunkSize;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Receiver of every add and cancel of an order which a cache applied, e.g.
+// OrderJournal. The cache calls it while the lock of the order id is held,
+// so mutations of one id arrive in their order.
+class OrderLog {
+public:
+  virtual void add(std::string_view orderId, std::string_view securityId,
+                   std::string_view side, unsigned int qty,
+                   std::string_view user, std::string_view company) = 0;
+  virtual void cancel(std::string_view orderId) = 0;
+  // position of the log after the last mutation, saved with snapshots
+  virtual std::uint64_t position() const = 0;
+  virtual ~OrderLog() = default;
+};
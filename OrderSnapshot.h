@@ -0,0 +1,190 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "OrderCache.h"
+#include "OrderFile.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// Snapshots of the orders of a cache, kept in order files (see OrderFile.h),
+// so OrderCache.h holds the in-memory structure only
+class OrderSnapshot {
+  using cache_type = OrderCache;
+  using format = OrderFileFormat;
+
+public:
+  // Write all orders, in insertion order, to an order file. String tables of
+  // the file are the interned names of the cache, so load() interns every
+  // name only once. Returns false when the file cannot be written
+  static bool save(const OrderCache &cache, const std::string &path) {
+    OrderFileWriter writer;
+    {
+      std::vector<std::shared_lock<std::shared_mutex>> locks;
+      for (const auto &slice : cache.m_stripes) {
+        locks.emplace_back(slice.mutex);
+      }
+      auto copy_names = [&writer](format::table table,
+                                  const cache_type::namesTable &names) {
+        std::shared_lock<std::shared_mutex> lock(names.mutex);
+        for (std::size_t id = 0; id < names.names.size(); ++id) {
+          writer.intern(
+              table, names.names[static_cast<cache_type::internedId>(id)]);
+        }
+      };
+      for (std::size_t id = 0; id < cache.m_securities.size(); ++id) {
+        writer.intern(
+            format::securities,
+            cache.m_securities[static_cast<cache_type::internedId>(id)].name);
+      }
+      copy_names(format::users, cache.m_users);
+      copy_names(format::companies, cache.m_companies);
+
+      // no mutation is journaled while the stripes are locked
+      writer.set_journal_position(cache.m_journal ? cache.m_journal->position()
+                                                  : 0);
+      cache.for_each_in_order([&writer](const cache_type::orderEntry &order) {
+        writer.add(cache_type::id_of(order),
+                   {order.securityKey, order.userKey, order.companyKey,
+                    writer.intern(format::sides, cache_type::side_of(order)),
+                    order.qty()});
+      });
+    }
+
+    // the file is written when no lock is held
+    if (!writer.save(path)) {
+      std::cerr << "Failed to save snapshot: " << path << '\n';
+      return false;
+    }
+    return true;
+  }
+
+  // Replace orders of the cache with orders of a snapshot (or of any order
+  // file). The file is validated before the cache is touched, returns false
+  // when it cannot be loaded. Restored orders are not journaled, so a cache
+  // with a journal is refused: the journal would not match the cache. Attach
+  // the journal after the restore, then replay the journal tail
+  static bool load(OrderCache &cache, const std::string &path) {
+    MappedFile file;
+    OrderFileView snapshot;
+    if (!file.open(path, 0) || !snapshot.open(file.data(), file.size())) {
+      std::cerr << "Failed to load snapshot: " << path << '\n';
+      return false;
+    }
+    return load(cache, snapshot);
+  }
+
+  // Replace orders of the cache with orders of an opened order file. Every
+  // name of the file is interned once, not once per order, every record is
+  // checked once and the stores are grown once for all orders, which are
+  // then built from the mapped strings. Returns false, with the cache not
+  // changed, when the cache has a journal
+  static bool load(OrderCache &cache, const OrderFileView &snapshot) {
+    if (cache.m_journal) {
+      std::cerr << "Failed to load snapshot: the cache has a journal\n";
+      return false;
+    }
+
+    // interned ids of the table strings, npos for names orders cannot have
+    auto intern_table = [&snapshot](format::table table,
+                                    cache_type::namesTable &names,
+                                    bool required) {
+      std::vector<cache_type::internedId> ids;
+      for (std::size_t index = 0; index < snapshot.table_size(table);
+           ++index) {
+        auto name = snapshot.string(table, index);
+        ids.push_back(required && name.empty()
+                          ? StringInterner::npos
+                          : cache_type::intern(names, name));
+      }
+      return ids;
+    };
+    std::vector<cache_type::securitiesTable::entry *> securities;
+    for (std::size_t index = 0;
+         index < snapshot.table_size(format::securities); ++index) {
+      auto name = snapshot.string(format::securities, index);
+      securities.push_back(name.empty() ? nullptr
+                                        : &cache.m_securities.intern(name));
+    }
+    auto users = intern_table(format::users, cache.m_users, true);
+    auto companies = intern_table(format::companies, cache.m_companies, false);
+    std::vector<std::atomic<std::uint64_t> *> userStripes;
+    for (auto user : users) {
+      userStripes.push_back(user == StringInterner::npos
+                                ? nullptr
+                                : &cache.user_stripes(user));
+    }
+    std::vector<std::optional<cache_type::orderSide>> sides;
+    for (std::size_t index = 0; index < snapshot.table_size(format::sides);
+         ++index) {
+      sides.push_back(
+          cache_type::parse_side(snapshot.string(format::sides, index)));
+    }
+
+    // the same checks as validate_order(), but on the tables
+    auto prepare =
+        [&](std::size_t index) -> std::optional<cache_type::pendingOrder> {
+      auto order = snapshot.record(index);
+      if (snapshot.string(format::orderIds, index).empty() ||
+          !securities[order.security] ||
+          users[order.user] == StringInterner::npos || !order.qty ||
+          !sides[order.side]) {
+        return std::nullopt;
+      }
+      auto *security = securities[order.security];
+      return cache_type::pendingOrder{*sides[order.side],
+                                      security->id,
+                                      users[order.user],
+                                      companies[order.company],
+                                      userStripes[order.user],
+                                      &security->value};
+    };
+    std::vector<std::optional<cache_type::pendingOrder>> keys;
+    std::vector<std::size_t> perStripe(cache.m_stripes.size());
+    std::vector<std::size_t> textIds(cache.m_idShards.size());
+    keys.reserve(snapshot.size());
+    for (std::size_t index = 0; index < snapshot.size(); ++index) {
+      keys.push_back(prepare(index));
+      if (keys.back()) {
+        ++perStripe[cache.stripe_of(keys.back()->security)];
+        auto id = cache.id_key(snapshot.string(format::orderIds, index));
+        if (!id.number) {
+          ++textIds[cache.id_shard_index(id)];
+        }
+      }
+    }
+
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    for (auto &slice : cache.m_stripes) {
+      locks.emplace_back(slice.mutex);
+    }
+    cache.clear_orders();
+    for (std::size_t index = 0; index < cache.m_stripes.size(); ++index) {
+      cache.m_stripes[index].orders.reserve(perStripe[index]);
+    }
+    cache.reserve_text_ids(textIds);
+
+    // the stored strings are built from the mapped tables directly
+    cache.rebuild_orders(keys, [&snapshot](std::size_t index) {
+      auto order = snapshot.record(index);
+      return cache_type::orderFields{
+          snapshot.string(format::orderIds, index),
+          snapshot.string(format::securities, order.security),
+          snapshot.string(format::sides, order.side),
+          order.qty,
+          snapshot.string(format::users, order.user),
+          snapshot.string(format::companies, order.company)};
+    });
+    for (auto &slice : cache.m_stripes) {
+      cache.publish_totals(slice);
+    }
+    return true;
+  }
+};
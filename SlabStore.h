@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Pooled storage for objects addressed by stable 32-bit handles.
+// Objects live in fixed size slabs which are never moved nor released before
+// the store is destroyed, so handles and references stay valid until the
+// object is erased. Erased slots are kept on a free list and reused by the
+// next insert, which means no allocation at all once the store has grown to
+// its working size. Live objects are chained in insertion order.
+template <typename T, std::size_t SlabCapacity = 4096> class SlabStore {
+public:
+  using handle = std::uint32_t;
+  static constexpr handle npos = std::numeric_limits<handle>::max();
+
+private:
+  struct Slot {
+    handle prev{npos};
+    handle next{npos};
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  static constexpr handle freed = npos - 1; // prev of a free slot
+
+  std::vector<std::unique_ptr<Slot[]>> m_slabs;
+  handle m_used{0};     // slots taken from slabs so far
+  handle m_free{npos};  // head of free slots chain
+  handle m_first{npos}; // oldest live object
+  handle m_last{npos};  // newest live object
+  std::size_t m_size{0};
+
+  Slot &slot(handle index) {
+    return m_slabs[index / SlabCapacity][index % SlabCapacity];
+  }
+  const Slot &slot(handle index) const {
+    return m_slabs[index / SlabCapacity][index % SlabCapacity];
+  }
+
+  static T *object(Slot &slot) {
+    return std::launder(reinterpret_cast<T *>(slot.storage));
+  }
+  static const T *object(const Slot &slot) {
+    return std::launder(reinterpret_cast<const T *>(slot.storage));
+  }
+
+  handle take_slot() {
+    if (m_free != npos) {
+      auto index = m_free;
+      m_free = slot(index).next;
+      return index;
+    }
+    if (m_used == m_slabs.size() * SlabCapacity) {
+      m_slabs.emplace_back(new Slot[SlabCapacity]);
+    }
+    return m_used++;
+  }
+
+public:
+  class const_iterator {
+    const SlabStore *m_store{nullptr};
+    handle m_index{npos};
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T *;
+    using reference = const T &;
+
+    const_iterator() = default;
+    const_iterator(const SlabStore *store, handle index)
+        : m_store(store), m_index(index) {}
+
+    reference operator*() const { return (*m_store)[m_index]; }
+    pointer operator->() const { return &(*m_store)[m_index]; }
+    const_iterator &operator++() {
+      m_index = m_store->next(m_index);
+      return *this;
+    }
+    const_iterator operator++(int) {
+      auto copy = *this;
+      ++*this;
+      return copy;
+    }
+    handle index() const { return m_index; }
+    bool operator==(const const_iterator &other) const {
+      return m_index == other.m_index;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return !(*this == other);
+    }
+  };
+
+  SlabStore() = default;
+  SlabStore(const SlabStore &) = delete;
+  SlabStore &operator=(const SlabStore &) = delete;
+  ~SlabStore() { clear(); }
+
+  // construct a new object at the end of insertion order and return its handle
+  template <typename... Args> handle emplace_back(Args &&...args) {
+    auto index = take_slot();
+    auto &target = slot(index);
+    try {
+      ::new (static_cast<void *>(target.storage))
+          T(std::forward<Args>(args)...);
+    } catch (...) {
+      target.prev = freed;
+      target.next = m_free;
+      m_free = index;
+      throw;
+    }
+    target.prev = m_last;
+    target.next = npos;
+    (m_last == npos ? m_first : slot(m_last).next) = index;
+    m_last = index;
+    ++m_size;
+    return index;
+  }
+
+  // destroy the object and put its slot on the free list
+  void erase(handle index) {
+    auto &target = slot(index);
+    object(target)->~T();
+    (target.prev == npos ? m_first : slot(target.prev).next) = target.next;
+    (target.next == npos ? m_last : slot(target.next).prev) = target.prev;
+    target.prev = freed;
+    target.next = m_free;
+    m_free = index;
+    --m_size;
+  }
+
+  void clear() {
+    while (m_first != npos) {
+      erase(m_first);
+    }
+  }
+
+  // make sure the next count inserts do not allocate new slabs
+  void reserve(std::size_t count) {
+    while (m_slabs.size() * SlabCapacity < m_used + count) {
+      m_slabs.emplace_back(new Slot[SlabCapacity]);
+    }
+  }
+
+  T &operator[](handle index) { return *object(slot(index)); }
+  const T &operator[](handle index) const { return *object(slot(index)); }
+
+  // whether the handle addresses a live object (which may be other than
+  // the one it was given for, slots are reused)
+  bool contains(handle index) const {
+    return index < m_used && slot(index).prev != freed;
+  }
+
+  handle first() const { return m_first; }
+  handle next(handle index) const { return slot(index).next; }
+
+  std::size_t size() const { return m_size; }
+  bool empty() const { return !m_size; }
+
+  const T &front() const { return (*this)[m_first]; }
+  const T &back() const { return (*this)[m_last]; }
+
+  const_iterator begin() const { return {this, m_first}; }
+  const_iterator end() const { return {this, npos}; }
+};
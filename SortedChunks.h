@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// Sorted multiset kept in chunks of at most ChunkCapacity values, i.e. a
+// B-tree of one level. The first value of every chunk is kept in a separate
+// array for binary search, so insert and erase move values of one chunk
+// only, and all values from a bound on (a suffix) are taken in O(log n + k).
+template <typename T, std::size_t ChunkCapacity = 256> class SortedChunks {
+  std::vector<std::vector<T>> m_chunks;
+  std::vector<T> m_firsts; // first value of every chunk
+  std::size_t m_size{0};
+
+  // the last chunk which first value is not greater than the value, or 0
+  std::size_t chunk_of(const T &value) const {
+    auto after = std::upper_bound(m_firsts.begin(), m_firsts.end(), value);
+    return after == m_firsts.begin()
+               ? 0
+               : static_cast<std::size_t>(after - m_firsts.begin() - 1);
+  }
+
+  void remove_chunk(std::size_t index) {
+    m_chunks.erase(m_chunks.begin() + static_cast<std::ptrdiff_t>(index));
+    m_firsts.erase(m_firsts.begin() + static_cast<std::ptrdiff_t>(index));
+  }
+
+public:
+  std::size_t size() const { return m_size; }
+  bool empty() const { return !m_size; }
+
+  void insert(const T &value) {
+    if (m_chunks.empty()) {
+      m_chunks.emplace_back().reserve(ChunkCapacity);
+      m_firsts.push_back(value);
+    }
+    auto index = chunk_of(value);
+    auto &chunk = m_chunks[index];
+    chunk.insert(std::upper_bound(chunk.begin(), chunk.end(), value), value);
+    m_firsts[index] = chunk.front();
+    ++m_size;
+    if (chunk.size() > ChunkCapacity) {
+      // the upper half moves to a new chunk
+      auto half = static_cast<std::ptrdiff_t>(chunk.size() / 2);
+      std::vector<T> upper;
+      upper.reserve(ChunkCapacity);
+      upper.assign(chunk.begin() + half, chunk.end());
+      chunk.erase(chunk.begin() + half, chunk.end());
+      auto at = static_cast<std::ptrdiff_t>(index + 1);
+      m_firsts.insert(m_firsts.begin() + at, upper.front());
+      m_chunks.insert(m_chunks.begin() + at, std::move(upper));
+    }
+  }
+
+  // returns false when the value is not there
+  bool erase(const T &value) {
+    if (m_chunks.empty()) {
+      return false;
+    }
+    auto index = chunk_of(value);
+    auto &chunk = m_chunks[index];
+    auto found = std::lower_bound(chunk.begin(), chunk.end(), value);
+    if (found == chunk.end() || *found != value) {
+      return false;
+    }
+    chunk.erase(found);
+    --m_size;
+    if (chunk.empty()) {
+      remove_chunk(index);
+    } else {
+      m_firsts[index] = chunk.front();
+    }
+    return true;
+  }
+
+  // Calls visit(value) for every value not less than `from`, in ascending
+  // order, and removes them. The set must not be changed by visit()
+  template <typename Visit> void erase_from(const T &from, Visit &&visit) {
+    // chunks after the last one starting below `from` are taken whole
+    auto index = static_cast<std::size_t>(
+        std::lower_bound(m_firsts.begin(), m_firsts.end(), from) -
+        m_firsts.begin());
+    if (index) {
+      --index;
+    }
+    for (auto chunk = index; chunk < m_chunks.size(); ++chunk) {
+      auto &values = m_chunks[chunk];
+      auto first = chunk == index
+                       ? std::lower_bound(values.begin(), values.end(), from)
+                       : values.begin();
+      for (auto value = first; value != values.end(); ++value) {
+        visit(*value);
+      }
+      m_size -= static_cast<std::size_t>(std::distance(first, values.end()));
+      values.erase(first, values.end());
+    }
+    auto kept = index < m_chunks.size() && !m_chunks[index].empty()
+                    ? index + 1
+                    : index;
+    m_chunks.resize(kept);
+    m_firsts.resize(kept);
+  }
+
+  // replace the values with sorted ones. Chunks are filled to a half, as
+  // after a split, so the next inserts do not split them at once
+  void assign(const std::vector<T> &sorted) {
+    clear();
+    constexpr std::size_t fill{ChunkCapacity / 2 ? ChunkCapacity / 2 : 1};
+    for (std::size_t first = 0; first < sorted.size(); first += fill) {
+      auto &chunk = m_chunks.emplace_back();
+      chunk.reserve(ChunkCapacity);
+      chunk.assign(sorted.begin() + static_cast<std::ptrdiff_t>(first),
+                   sorted.begin() + static_cast<std::ptrdiff_t>(std::min(
+                                        first + fill, sorted.size())));
+      m_firsts.push_back(chunk.front());
+    }
+    m_size = sorted.size();
+  }
+
+  void clear() {
+    m_chunks.clear();
+    m_firsts.clear();
+    m_size = 0;
+  }
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "FlatHashMap.h"
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+
+// Maps every distinct string to a dense integer id, starting from 0, and back.
+// Ids are never released, so they can be used directly as vector indexes.
+class StringInterner {
+public:
+  using id_type = std::uint32_t;
+  static constexpr id_type npos = std::numeric_limits<id_type>::max();
+
+  // id of the string, a new one is assigned on the first call
+  id_type intern(std::string_view text) {
+    if (auto *position = m_ids.find(text)) {
+      return position->second;
+    }
+    auto id = static_cast<id_type>(m_strings.size());
+    // the deque never moves stored strings, so the key views stay valid
+    m_ids.try_emplace(m_strings.emplace_back(text), id);
+    return id;
+  }
+
+  // id of an already interned string or npos
+  id_type find(std::string_view text) const {
+    const auto *position = m_ids.find(text);
+    return position ? position->second : npos;
+  }
+
+  std::string_view operator[](id_type id) const { return m_strings[id]; }
+
+  std::size_t size() const { return m_strings.size(); }
+
+private:
+  std::deque<std::string> m_strings;
+  FlatHashMap<std::string_view, id_type> m_ids;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads which are kept to help callers with their parallel work. A caller
+// runs a task on its own thread and on as many idle workers as it asks for,
+// so it never waits for a busy pool: requests which no worker took before
+// the caller finished its own run are withdrawn. Tasks therefore share the
+// work through their own state, e.g. an atomic cursor. Workers are started
+// when they are first needed and live as long as the pool.
+class WorkerPool {
+  struct job {
+    const std::function<void()> *task;
+    unsigned running{0}; // workers which took the job and did not finish
+  };
+
+public:
+  WorkerPool() = default;
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_queued.notify_all();
+    for (auto &worker : m_workers) {
+      worker.join();
+    }
+  }
+
+  // run the task on the calling thread and on at most `helpers` workers at
+  // once. Returns when every run of the task has finished
+  void run(unsigned helpers, const std::function<void()> &task) {
+    job current{&task};
+    if (helpers) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      while (m_workers.size() < helpers) {
+        m_workers.emplace_back([this] { work(); });
+      }
+      m_jobs.insert(m_jobs.end(), helpers, &current);
+    }
+    m_queued.notify_all();
+    task();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobs.erase(std::remove(m_jobs.begin(), m_jobs.end(), &current),
+                 m_jobs.end());
+    m_finished.wait(lock, [&] { return !current.running; });
+  }
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_workers.size();
+  }
+
+private:
+  void work() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+      m_queued.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+      if (m_stop) {
+        return;
+      }
+      auto *taken = m_jobs.front();
+      m_jobs.pop_front();
+      ++taken->running;
+      lock.unlock();
+      (*taken->task)();
+      lock.lock();
+      if (!--taken->running) {
+        m_finished.notify_all();
+      }
+    }
+  }
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_queued;   // for workers
+  std::condition_variable m_finished; // for callers
+  std::deque<job *> m_jobs;           // one entry per requested helper
+  std::vector<std::thread> m_workers;
+  bool m_stop{false};
+};
@@ -0,0 +1,672 @@
+#include "../MappedFile.h"
+#include "../OrderCache.h"
+#include "../OrderFile.h"
+#include "../OrderJournal.h"
+#include "../OrderLoader.h"
+#include "../OrderSnapshot.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Small micro benchmarks for OrderCache. Every benchmark is registered by name
+// in main(), run all of them or pass the names to run as arguments.
+
+namespace {
+std::atomic<std::size_t> allocations{0};
+} // namespace
+
+// count every heap allocation, so benchmarks can report allocations per call
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto *memory = std::malloc(size ? size : 1)) {
+    return memory;
+  }
+  throw std::bad_alloc{};
+}
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+double elapsed_ns(clock_type::time_point start) {
+  return std::chrono::duration<double, std::nano>(clock_type::now() - start)
+      .count();
+}
+
+std::string order_id(std::size_t number) {
+  return "OrdId" + std::to_string(number);
+}
+
+// cancel latency for one hot security (and one hot user) with growing buckets
+void cancel_latency() {
+  std::puts("cancel_latency: ns per cancelOrder on a single hot bucket");
+  constexpr std::size_t cancels{1000};
+  for (std::size_t bucket_size : {1000u, 10000u, 100000u}) {
+    OrderCache cache;
+    for (std::size_t i = 0; i < bucket_size; ++i) {
+      cache.addOrder(Order{order_id(i), "SecId1", i % 2 ? "Buy" : "Sell",
+                           100, "User1", "Company1"});
+    }
+
+    std::vector<std::string> victims;
+    std::mt19937 generator{42};
+    std::uniform_int_distribution<std::size_t> pick(0, bucket_size - 1);
+    std::map<std::size_t, bool> picked;
+    while (victims.size() < cancels) {
+      auto number = pick(generator);
+      if (!picked[number]) {
+        picked[number] = true;
+        victims.push_back(order_id(number));
+      }
+    }
+
+    auto start = clock_type::now();
+    for (const auto &victim : victims) {
+      cache.cancelOrder(victim);
+    }
+    std::printf("  bucket %7zu: %8.1f ns/cancel\n", bucket_size,
+                elapsed_ns(start) / cancels);
+  }
+}
+
+// cancelOrdersForSecIdWithMinimumQty on one big security with selective
+// thresholds (qty is uniform in 1..10000), only the cancel is timed
+void cancel_min_qty() {
+  std::puts("cancel_min_qty: us per cancelOrdersForSecIdWithMinimumQty");
+  for (std::size_t bucket_size : {10000u, 100000u, 500000u}) {
+    for (unsigned int min_qty : {9990u, 9900u, 9000u}) {
+      OrderCache cache;
+      std::mt19937 generator{3};
+      for (std::size_t i = 0; i < bucket_size; ++i) {
+        auto qty = static_cast<unsigned int>(1 + generator() % 10000);
+        cache.addOrder(Order{order_id(i), "SecId1", i % 2 ? "Buy" : "Sell",
+                             qty, "User1", "Company1"});
+      }
+      auto start = clock_type::now();
+      cache.cancelOrdersForSecIdWithMinimumQty("SecId1", min_qty);
+      auto time = elapsed_ns(start);
+      std::printf("  bucket %7zu, qty >= %5u: %10.1f us\n", bucket_size,
+                  min_qty, time / 1e3);
+    }
+  }
+}
+
+std::vector<Order> make_orders(std::size_t count, std::size_t securities,
+                               std::size_t users, std::size_t companies) {
+  std::vector<Order> orders;
+  orders.reserve(count);
+  std::mt19937 generator{7};
+  for (std::size_t i = 0; i < count; ++i) {
+    orders.emplace_back(order_id(i),
+                        "SecId" + std::to_string(generator() % securities),
+                        generator() % 2 ? "Buy" : "Sell",
+                        1 + generator() % 10000,
+                        "User" + std::to_string(generator() % users),
+                        "Company" + std::to_string(generator() % companies));
+  }
+  return orders;
+}
+
+// addOrder throughput and allocations, on an empty cache and in steady state
+// where the same orders are added again after all of them were cancelled.
+// Orders are copied before the clock starts and moved into the cache. Names
+// longer than the small string buffer show every copy of a name as an
+// allocation
+void add_throughput() {
+  std::puts("add_throughput: 200k orders, 1000 securities, 2000 users");
+  auto short_names = make_orders(200000, 1000, 2000, 100);
+  std::vector<Order> long_names;
+  long_names.reserve(short_names.size());
+  const std::string prefix{"exchange-0042/"};
+  for (const auto &order : short_names) {
+    long_names.emplace_back(prefix + order.orderId(),
+                            prefix + order.securityId(), order.side(),
+                            order.qty(), prefix + order.user(),
+                            prefix + order.company());
+  }
+
+  for (const auto *orders : {&short_names, &long_names}) {
+    OrderCache cache;
+    auto add_all = [&](const char *label) {
+      auto copies = *orders;
+      auto before = allocations.load();
+      auto start = clock_type::now();
+      for (auto &order : copies) {
+        cache.addOrder(std::move(order));
+      }
+      auto time = elapsed_ns(start);
+      std::printf("  %-6s %-6s: %8.1f ns/add, %6.2f allocations/add\n",
+                  orders == &short_names ? "short" : "long", label,
+                  time / orders->size(),
+                  double(allocations.load() - before) / orders->size());
+    };
+
+    add_all("cold");
+    for (const auto &order : *orders) {
+      cache.cancelOrder(order.orderId());
+    }
+    add_all("steady");
+  }
+}
+
+// addOrder and cancelOrder latency with "OrdId<N>" ids indexed by number
+// and with the codec off, where every id is indexed by text
+void order_ids() {
+  constexpr std::size_t count{500000};
+  std::printf("order_ids: %zu orders\n", count);
+  auto orders = make_orders(count, 1000, 2000, 100);
+
+  for (bool numeric : {true, false}) {
+    OrderCache cache{16, numeric ? OrderIdCodec{"OrdId"} : OrderIdCodec{}};
+    auto copies = orders;
+    auto start = clock_type::now();
+    for (auto &order : copies) {
+      cache.addOrder(std::move(order));
+    }
+    auto add = elapsed_ns(start) / count;
+
+    start = clock_type::now();
+    for (std::size_t i = 0; i < count; i += 2) {
+      cache.cancelOrder(order_id(i));
+    }
+    auto cancel = elapsed_ns(start) / (count / 2);
+    std::printf("  %-8s: %8.1f ns/add, %8.1f ns/cancel\n",
+                numeric ? "numeric" : "text", add, cancel);
+  }
+}
+
+// getMatchingSizeForSecurity throughput with a growing number of readers
+void multi_reader() {
+  constexpr std::size_t securities{1000};
+  constexpr std::size_t queries_per_thread{50000};
+  std::printf("multi_reader: %zu matching queries per reader thread\n",
+              queries_per_thread);
+  OrderCache cache;
+  cache.addOrders(make_orders(200000, securities, 2000, 20));
+
+  std::vector<std::string> ids;
+  for (std::size_t i = 0; i < securities; ++i) {
+    ids.push_back("SecId" + std::to_string(i));
+  }
+
+  for (unsigned readers : {1u, 2u, 4u, 8u, 16u}) {
+    std::vector<std::thread> threads;
+    std::atomic<unsigned long long> checksum{0};
+    auto start = clock_type::now();
+    for (unsigned reader = 0; reader < readers; ++reader) {
+      threads.emplace_back([&, reader] {
+        unsigned long long sum{0};
+        for (std::size_t i = 0; i < queries_per_thread; ++i) {
+          sum += cache.getMatchingSizeForSecurity(
+              ids[(i * 7 + reader) % securities]);
+        }
+        checksum += sum;
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    auto seconds = elapsed_ns(start) / 1e9;
+    std::printf("  %2u readers: %10.0f queries/s, checksum %llu\n", readers,
+                readers * queries_per_thread / seconds, checksum.load());
+  }
+}
+
+// matching queries of all securities, computed and then repeated on the
+// same orders (memoised), and after one order per security changed
+void matching_memo() {
+  constexpr std::size_t securities{1000};
+  std::printf("matching_memo: %zu securities, 200k orders\n", securities);
+  OrderCache cache;
+  cache.addOrders(make_orders(200000, securities, 2000, 100));
+
+  std::vector<std::string> ids;
+  for (std::size_t i = 0; i < securities; ++i) {
+    ids.push_back("SecId" + std::to_string(i));
+  }
+  auto query_all = [&](const char *label) {
+    auto before = cache.getMatchingCacheStats();
+    unsigned long long checksum{0};
+    auto start = clock_type::now();
+    for (const auto &id : ids) {
+      checksum += cache.getMatchingSizeForSecurity(id);
+    }
+    auto time = elapsed_ns(start);
+    auto after = cache.getMatchingCacheStats();
+    std::printf(
+        "  %-10s: %8.1f ns/query, %4llu hits, %4llu misses, checksum %llu\n",
+        label, time / securities,
+        static_cast<unsigned long long>(after.hits - before.hits),
+        static_cast<unsigned long long>(after.misses - before.misses),
+        checksum);
+  };
+
+  query_all("computed");
+  query_all("memoised");
+  for (std::size_t i = 0; i < securities; ++i) {
+    cache.addOrder(Order{"Extra" + std::to_string(i), ids[i], "Buy", 1,
+                         "User0", "Company0"});
+  }
+  query_all("changed");
+}
+
+// getMatchingSizeForSecurity of one security with a growing number of
+// companies. An order is added and cancelled before every query, so the
+// result is never memoised; only the query is timed
+void matching_companies() {
+  constexpr std::size_t queries{200};
+  std::puts("matching_companies: one security, 100k orders");
+  for (std::size_t companies : {10u, 100u, 500u, 1000u}) {
+    OrderCache cache;
+    cache.addOrders(make_orders(100000, 1, 1000, companies));
+    double time{0};
+    unsigned long long checksum{0};
+    for (std::size_t i = 0; i < queries; ++i) {
+      cache.addOrder(Order{"Extra", "SecId0", "Buy", 1, "User0", "Company0"});
+      cache.cancelOrder("Extra");
+      auto start = clock_type::now();
+      checksum += cache.getMatchingSizeForSecurity("SecId0");
+      time += elapsed_ns(start);
+    }
+    std::printf("  %4zu companies: %10.1f ns/query, checksum %llu\n",
+                companies, time / queries, checksum);
+  }
+}
+
+// end of batch sweep of all securities: serial getMatchingSizeForSecurity
+// calls and getMatchingSizeForSecurities with a growing number of threads.
+// Every row uses a new cache, so no result is memoised
+void matching_sweep() {
+  constexpr std::size_t securities{10000};
+  std::printf("matching_sweep: %zu securities, 500k orders\n", securities);
+  auto orders = make_orders(500000, securities, 2000, 50);
+  std::vector<std::string> ids;
+  for (std::size_t i = 0; i < securities; ++i) {
+    ids.push_back("SecId" + std::to_string(i));
+  }
+
+  auto sweep = [&](const char *label, auto &&match) {
+    OrderCache cache;
+    cache.addOrders(orders);
+    auto start = clock_type::now();
+    auto checksum = match(cache);
+    std::printf("  %-20s: %8.1f ms, checksum %llu\n", label,
+                elapsed_ns(start) / 1e6, checksum);
+  };
+
+  sweep("serial", [&](OrderCache &cache) {
+    unsigned long long checksum{0};
+    for (const auto &id : ids) {
+      checksum += cache.getMatchingSizeForSecurity(id);
+    }
+    return checksum;
+  });
+  for (unsigned threads : {1u, 2u, 4u, 8u}) {
+    auto label = "bulk, " + std::to_string(threads) + " threads";
+    sweep(label.c_str(), [&](OrderCache &cache) {
+      unsigned long long checksum{0};
+      for (auto size : cache.getMatchingSizeForSecurities(ids, threads)) {
+        checksum += size;
+      }
+      return checksum;
+    });
+  }
+
+  // small calls, where starting threads for every call would dominate
+  std::vector<std::string> few;
+  for (std::size_t i = 0; i < 64; ++i) {
+    few.push_back(ids[i]);
+  }
+  sweep("1000 x 64, 4 threads", [&](OrderCache &cache) {
+    unsigned long long checksum{0};
+    for (int call = 0; call < 1000; ++call) {
+      for (auto size : cache.getMatchingSizeForSecurities(few, 4)) {
+        checksum += size;
+      }
+    }
+    return checksum;
+  });
+}
+
+// addOrder throughput of writers which target different securities, with a
+// single stripe (one lock for the whole cache) and with the default striping
+void striped_writers() {
+  constexpr std::size_t orders_per_thread{50000};
+  std::printf("striped_writers: %zu adds per writer thread\n",
+              orders_per_thread);
+  for (std::size_t stripes : {1u, 16u}) {
+    for (unsigned writers : {1u, 2u, 4u, 8u}) {
+      std::vector<std::vector<Order>> batches(writers);
+      for (unsigned writer = 0; writer < writers; ++writer) {
+        for (std::size_t i = 0; i < orders_per_thread; ++i) {
+          batches[writer].emplace_back(
+              order_id(writer * orders_per_thread + i),
+              "SecId" + std::to_string(writer * 100 + i % 100),
+              i % 2 ? "Buy" : "Sell", 100, "User" + std::to_string(i % 50),
+              "Company" + std::to_string(i % 10));
+        }
+      }
+
+      OrderCache cache{stripes};
+      std::vector<std::thread> threads;
+      auto start = clock_type::now();
+      for (unsigned writer = 0; writer < writers; ++writer) {
+        threads.emplace_back([&, writer] {
+          for (const auto &order : batches[writer]) {
+            cache.addOrder(order);
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      auto seconds = elapsed_ns(start) / 1e9;
+      std::printf("  %2zu stripes, %u writers: %10.0f adds/s\n", stripes,
+                  writers, writers * orders_per_thread / seconds);
+    }
+  }
+}
+
+// writes orders the same way as test/data_generator.py does
+std::string write_json_orders(const std::vector<Order> &orders) {
+  auto path =
+      (std::filesystem::temp_directory_path() / "OrderCache_bench.json")
+          .string();
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << "[\n";
+  for (std::size_t i = 0; i < orders.size(); ++i) {
+    const auto &order = orders[i];
+    file << "    {\n        \"OrdId\": \"" << order.orderId()
+         << "\",\n        \"SecId\": \"" << order.securityId()
+         << "\",\n        \"TransactionType\": \"" << order.side()
+         << "\",\n        \"Amount\": \"" << order.qty()
+         << "\",\n        \"User\": \"" << order.user()
+         << "\",\n        \"Company\": \"" << order.company() << "\"\n    }"
+         << (i + 1 == orders.size() ? "\n" : ",\n");
+  }
+  file << "]";
+  return path;
+}
+
+// Time to load a JSON file (or the same orders from an order file) into the
+// cache. Every loader adds orders in batches of 4096, so only reading and
+// parsing differ
+void json_load() {
+  constexpr std::size_t count{500000};
+  auto orders = make_orders(count, 1000, 2000, 100);
+  auto path = write_json_orders(orders);
+  std::printf("json_load: %zu orders, %.1f MB file\n", count,
+              std::filesystem::file_size(path) / 1e6);
+
+  auto measure = [&](const char *label,
+                     const std::function<void(std::function<void(Order &&)>)>
+                         &load) {
+    OrderCache cache;
+    std::vector<Order> batch;
+    auto start = clock_type::now();
+    load([&](Order &&order) {
+      batch.push_back(std::move(order));
+      if (batch.size() == 4096) {
+        cache.addOrders(std::move(batch));
+        batch.clear();
+      }
+    });
+    cache.addOrders(std::move(batch));
+    std::printf("  %-28s: %8.1f ms, %zu orders\n", label,
+                elapsed_ns(start) / 1e6, cache.lookAtList().size());
+  };
+
+  measure("istreambuf + dom (previous)", [&](auto on_order) {
+    std::ifstream file(path, std::ios::binary);
+    std::string json((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+    simdjson::dom::parser parser;
+    for (auto item : parser.parse(json).get_array()) {
+      std::string amount{item["Amount"].get_string().value()};
+      on_order(Order{std::string{item["OrdId"].get_string().value()},
+                     std::string{item["SecId"].get_string().value()},
+                     std::string{item["TransactionType"].get_string().value()},
+                     static_cast<unsigned>(std::atoll(amount.c_str())),
+                     std::string{item["User"].get_string().value()},
+                     std::string{item["Company"].get_string().value()}});
+    }
+  });
+  measure("stream + on demand", [&](auto on_order) {
+    std::ifstream file(path, std::ios::binary);
+    JsonOrderReader{}.read(file, on_order);
+  });
+  measure("mmap + on demand", [&](auto on_order) {
+    MappedFile mapped;
+    mapped.open(path, simdjson::SIMDJSON_PADDING);
+    JsonOrderReader{}.read(mapped.data(), mapped.size(), on_order);
+  });
+
+  // the parallel loader hands over whole parsed chunks instead of orders
+  for (unsigned threads : {2u, 4u, 8u}) {
+    OrderCache cache;
+    auto start = clock_type::now();
+    MappedFile mapped;
+    mapped.open(path, simdjson::SIMDJSON_PADDING);
+    ParallelOrderLoader{threads}.read(
+        mapped.data(), mapped.size(), [&](std::vector<Order> &&orders) {
+          cache.addOrders(std::move(orders));
+        });
+    auto label = "mmap + parallel, " + std::to_string(threads) + " threads";
+    std::printf("  %-28s: %8.1f ms, %zu orders\n", label.c_str(),
+                elapsed_ns(start) / 1e6, cache.lookAtList().size());
+  }
+  std::filesystem::remove(path);
+
+  OrderFileWriter writer;
+  for (const auto &order : orders) {
+    writer.add(order.orderId(), order.securityId(), order.side(), order.qty(),
+               order.user(), order.company());
+  }
+  auto binary_path =
+      (std::filesystem::temp_directory_path() / "OrderCache_bench.bin")
+          .string();
+  writer.save(binary_path);
+  // order files are loaded in bulk, like main.cpp --format=bin does
+  {
+    OrderCache cache;
+    auto start = clock_type::now();
+    MappedFile mapped;
+    OrderFileView view;
+    mapped.open(binary_path, 0);
+    view.open(mapped.data(), mapped.size());
+    OrderSnapshot::load(cache, view);
+    std::printf("  %-28s: %8.1f ms, %zu orders\n", "mmap + order file (bulk)",
+                elapsed_ns(start) / 1e6, cache.lookAtList().size());
+  }
+  std::printf("  order file is %.1f MB\n",
+              std::filesystem::file_size(binary_path) / 1e6);
+  std::filesystem::remove(binary_path);
+}
+
+// reading all orders by copying them (getAllOrders), by visiting them under
+// all stripe locks (forEachOrder) and by visiting pages which lock one
+// stripe at a time (forEachOrderPage)
+void all_orders() {
+  constexpr std::size_t count{500000};
+  std::printf("all_orders: %zu orders\n", count);
+  OrderCache cache;
+  cache.addOrders(make_orders(count, 1000, 2000, 100));
+
+  std::size_t quantity{0};
+  auto sum = [&quantity](const Order &order) { quantity += order.qty(); };
+  auto report = [](const char *label, double time, std::size_t allocated) {
+    std::printf("  %-28s: %8.1f ms, %zu allocations\n", label, time / 1e6,
+                allocated);
+  };
+
+  auto before = allocations.load();
+  auto start = clock_type::now();
+  for (const auto &order : cache.getAllOrders()) {
+    sum(order);
+  }
+  report("getAllOrders", elapsed_ns(start), allocations.load() - before);
+
+  before = allocations.load();
+  start = clock_type::now();
+  cache.forEachOrder(sum);
+  report("forEachOrder", elapsed_ns(start), allocations.load() - before);
+
+  for (std::size_t page_size : {100u, 1000u, 10000u}) {
+    before = allocations.load();
+    double longest{0};
+    start = clock_type::now();
+    OrderCache::orderCursor cursor;
+    while (!cursor.finished()) {
+      auto page_start = clock_type::now();
+      cache.forEachOrderPage(cursor, page_size, sum);
+      longest = std::max(longest, elapsed_ns(page_start));
+    }
+    auto time = elapsed_ns(start);
+    auto label = "pages of " + std::to_string(page_size);
+    std::printf("  %-28s: %8.1f ms, %zu allocations, longest page %.1f us\n",
+                label.c_str(), time / 1e6, allocations.load() - before,
+                longest / 1e3);
+  }
+  if (!quantity) {
+    std::puts("  no orders");
+  }
+}
+
+// Time to rebuild the cache after a restart, by replaying the JSON file of
+// its orders and by restoring a snapshot
+void snapshot() {
+  constexpr std::size_t count{500000};
+  auto orders = make_orders(count, 1000, 2000, 100);
+  auto json_path = write_json_orders(orders);
+  auto snapshot_path =
+      (std::filesystem::temp_directory_path() / "OrderCache_bench.snapshot")
+          .string();
+  std::printf("snapshot: %zu orders\n", count);
+
+  {
+    OrderCache cache;
+    auto start = clock_type::now();
+    MappedFile mapped;
+    mapped.open(json_path, simdjson::SIMDJSON_PADDING);
+    std::vector<Order> batch;
+    JsonOrderReader{}.read(mapped.data(), mapped.size(), [&](Order &&order) {
+      batch.push_back(std::move(order));
+      if (batch.size() == 4096) {
+        cache.addOrders(std::move(batch));
+        batch.clear();
+      }
+    });
+    cache.addOrders(std::move(batch));
+    std::printf("  %-28s: %8.1f ms, %zu orders\n", "json replay",
+                elapsed_ns(start) / 1e6, cache.lookAtList().size());
+
+    start = clock_type::now();
+    OrderSnapshot::save(cache, snapshot_path);
+    std::printf("  %-28s: %8.1f ms, %.1f MB\n", "OrderSnapshot::save",
+                elapsed_ns(start) / 1e6,
+                std::filesystem::file_size(snapshot_path) / 1e6);
+  }
+
+  OrderCache cache;
+  auto start = clock_type::now();
+  OrderSnapshot::load(cache, snapshot_path);
+  std::printf("  %-28s: %8.1f ms, %zu orders\n", "OrderSnapshot::load",
+              elapsed_ns(start) / 1e6, cache.lookAtList().size());
+  std::filesystem::remove(json_path);
+  std::filesystem::remove(snapshot_path);
+}
+
+// addOrder latency without the journal, with the journal and group commit,
+// and with waiting for the disk after every add (no grouping at all)
+void journal() {
+  constexpr std::size_t count{200000};
+  std::printf("journal: ns per addOrder, %zu orders\n", count);
+  auto orders = make_orders(count, 1000, 2000, 100);
+  auto path =
+      (std::filesystem::temp_directory_path() / "OrderCache_bench.journal")
+          .string();
+
+  auto measure = [&](const char *label, OrderJournal *journal,
+                     std::size_t adds, bool sync) {
+    OrderCache cache;
+    cache.setJournal(journal);
+    auto start = clock_type::now();
+    for (std::size_t i = 0; i < adds; ++i) {
+      cache.addOrder(orders[i]);
+      if (sync) {
+        journal->sync();
+      }
+    }
+    auto time = elapsed_ns(start);
+    if (journal) {
+      journal->sync();
+    }
+    std::printf("  %-28s: %8.1f ns/add\n", label, time / adds);
+  };
+
+  measure("no journal", nullptr, count, false);
+  for (auto window : {100, 1000, 10000}) {
+    std::filesystem::remove(path);
+    OrderJournal journal{std::chrono::microseconds(window)};
+    journal.open(path);
+    auto label = "group commit, " + std::to_string(window) + " us";
+    measure(label.c_str(), &journal, count, false);
+  }
+  std::filesystem::remove(path);
+  OrderJournal journal;
+  journal.open(path);
+  measure("sync after every add", &journal, 2000, true);
+  journal.close();
+  std::filesystem::remove(path);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const std::map<std::string, void (*)()> benchmarks{
+      {"add_throughput", add_throughput},
+      {"all_orders", all_orders},
+      {"cancel_latency", cancel_latency},
+      {"cancel_min_qty", cancel_min_qty},
+      {"journal", journal},
+      {"json_load", json_load},
+      {"matching_companies", matching_companies},
+      {"matching_memo", matching_memo},
+      {"matching_sweep", matching_sweep},
+      {"multi_reader", multi_reader},
+      {"order_ids", order_ids},
+      {"snapshot", snapshot},
+      {"striped_writers", striped_writers},
+  };
+
+  if (argc == 1) {
+    for (const auto &[name, benchmark] : benchmarks) {
+      benchmark();
+    }
+    return 0;
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    auto benchmark = benchmarks.find(argv[i]);
+    if (benchmark == benchmarks.end()) {
+      std::cerr << "Unknown benchmark: " << argv[i] << '\n';
+      return 1;
+    }
+    benchmark->second();
+  }
+  return 0;
+}
@@ -1,61 +1,175 @@
+#include "MappedFile.h"
 #include "OrderCache.h"
-#include "lib/simdjson.h"
-#include <cstdlib>
+#include "OrderFile.h"
+#include "OrderLoader.h"
+#include "OrderSnapshot.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <csignal>
 #include <fstream>
 #include <iostream>
+#include <set>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
-int main(int argc, char **argv) {
-  using namespace std::string_literals;
-  // Path to your JSON file
-  std::string filename = argv[1];
-  if (filename.empty())
-    return 1;
+namespace {
+// set by SIGINT or SIGTERM, it ends tailing of the input file
+volatile std::sig_atomic_t stopped{0};
+} // namespace
 
-  // Read the entire file into a string
-  std::ifstream file(filename, std::ios::in | std::ios::binary);
-  if (!file.is_open()) {
-    std::cerr << "Failed to open file: " << filename << std::endl;
+int main(int argc, char **argv) {
+  // --threads=N parses the file and matches securities with N threads,
+  // --format=ndjson reads one order per line, --format=bin reads an order
+  // file (see OrderFile.h), --follow keeps reading the file while it grows
+  // (until the program is interrupted) and --id-prefix=P indexes ids made of
+  // P and a number by number (see OrderIdCodec.h), the other arguments are
+  // positional
+  unsigned threads{std::max(1u, std::thread::hardware_concurrency())};
+  JsonLayout layout{JsonLayout::array};
+  bool binary{false};
+  bool follow{false};
+  // ids of test/data_generator.py
+  std::string idPrefix{"OrdId"};
+  auto usage = [&argv] {
+    std::cerr << "Usage: " << argv[0]
+              << " file [match] [verbose] [--threads=N]"
+                 " [--format=json|ndjson|bin] [--follow] [--id-prefix=P]\n";
     return 1;
+  };
+  std::vector<std::string> args{argv[0]};
+  for (int i = 1; i < argc; ++i) {
+    std::string arg{argv[i]};
+    if (arg.rfind("--threads=", 0) == 0) {
+      auto *end = arg.data() + arg.size();
+      auto parsed = std::from_chars(arg.data() + 10, end, threads);
+      if (parsed.ec != std::errc{} || parsed.ptr != end || !threads) {
+        return usage();
+      }
+    } else if (arg == "--format=ndjson") {
+      layout = JsonLayout::lines;
+    } else if (arg == "--format=json") {
+      layout = JsonLayout::array;
+    } else if (arg == "--format=bin") {
+      binary = true;
+    } else if (arg == "--follow") {
+      follow = true;
+    } else if (arg.rfind("--id-prefix=", 0) == 0) {
+      idPrefix = arg.substr(12);
+    } else {
+      args.push_back(std::move(arg));
+    }
   }
-  std::string json_str((std::istreambuf_iterator<char>(file)),
-                       std::istreambuf_iterator<char>());
+  argc = static_cast<int>(args.size());
 
-  // Parse the JSON string
-  simdjson::dom::parser parser;
-  simdjson::dom::element json_data;
-  auto error = parser.parse(json_str).get(json_data);
-  if (error) {
-    std::cerr << "Failed to parse JSON: " << error << std::endl;
-    return 1;
-  }
+  // Path to your JSON file
+  if (argc < 2)
+    return usage();
+  std::string filename = args[1];
+  if (filename.empty())
+    return usage();
 
-  OrderCache cache;
+  OrderCache cache{16, OrderIdCodec{idPrefix}};
   std::set<std::string> securityIds;
 
-  // Iterate over the JSON array
-  for (const auto &item : json_data.get_array()) {
+  // Orders are streamed from the file and added in batches, the whole
+  // document is never held in memory
+  constexpr std::size_t batch_size{4096};
+  std::vector<Order> batch;
+  batch.reserve(batch_size);
+  auto flush = [&] {
+    cache.addOrders(std::move(batch));
+    batch.clear();
+    batch.reserve(batch_size);
+  };
 
-    std::string ord_id{item["OrdId"].get_string().value()};
-    std::string sec_id{item["SecId"].get_string().value()};
-    std::string transaction_type{item["TransactionType"].get_string().value()};
-    std::string amount{item["Amount"].get_string().value()};
-    std::string user{item["User"].get_string().value()};
-    std::string company{item["Company"].get_string().value()};
-    cache.addOrder(Order{ord_id, sec_id, transaction_type,
-                         static_cast<unsigned>(std::atoll(amount.c_str())),
-                         user, company});
-    securityIds.emplace(sec_id);
+  auto record_fields = [&](std::string_view orderId,
+                           std::string_view securityId, std::string_view side,
+                           unsigned int qty, std::string_view user,
+                           std::string_view company) {
+    securityIds.emplace(securityId);
     if (argc == 4) {
       // thirdth argument is like verbose flag
-      std::cout << "Order ID: " << ord_id << ", ";
-      std::cout << "Security ID: " << sec_id << ", ";
-      std::cout << "Transaction Type: " << transaction_type << ", ";
-      std::cout << "Amount: " << amount << ", ";
+      std::cout << "Order ID: " << orderId << ", ";
+      std::cout << "Security ID: " << securityId << ", ";
+      std::cout << "Transaction Type: " << side << ", ";
+      std::cout << "Amount: " << qty << ", ";
       std::cout << "User: " << user << ", ";
       std::cout << "Company: " << company << std::endl;
     }
+  };
+  auto record = [&](const Order &order) {
+    record_fields(order.orderId(), order.securityId(), order.side(),
+                  order.qty(), order.user(), order.company());
+  };
+  auto on_order = [&](Order &&order) {
+    record(order);
+    batch.push_back(std::move(order));
+    if (batch.size() == batch_size) {
+      flush();
+    }
+  };
+
+  // The file is mapped and parsed in place, by several threads when there
+  // are more than one. When it cannot be mapped (i.e. it is a pipe) or it is
+  // followed it is read in chunks instead
+  JsonOrderReader reader{layout};
+  simdjson::error_code error{simdjson::SUCCESS};
+  MappedFile mapped;
+  if (binary) {
+    // order files are only mapped, there is nothing to parse, and the
+    // cache is built from the mapped strings in one pass like a snapshot
+    OrderFileView orders;
+    if (!mapped.open(filename, 0) ||
+        !orders.open(mapped.data(), mapped.size())) {
+      std::cerr << "Failed to load order file: " << filename << std::endl;
+      return 1;
+    }
+    orders.read(record_fields);
+    if (!OrderSnapshot::load(cache, orders)) {
+      return 1;
+    }
+  } else if (follow) {
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+      std::cerr << "Failed to open file: " << filename << std::endl;
+      return 1;
+    }
+    std::signal(SIGINT, [](int) { stopped = 1; });
+    std::signal(SIGTERM, [](int) { stopped = 1; });
+    // orders read so far are added before waiting for more
+    error = reader.follow(file, on_order, [&] {
+      flush();
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      return !stopped;
+    });
+  } else if (mapped.open(filename, simdjson::SIMDJSON_PADDING) &&
+             threads > 1) {
+    error = ParallelOrderLoader{threads, layout}.read(
+        mapped.data(), mapped.size(), [&](std::vector<Order> &&orders) {
+          for (const auto &order : orders) {
+            record(order);
+          }
+          cache.addOrders(std::move(orders));
+        });
+  } else if (mapped.is_open()) {
+    error = reader.read(mapped.data(), mapped.size(), on_order);
+  } else {
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+      std::cerr << "Failed to open file: " << filename << std::endl;
+      return 1;
+    }
+    error = reader.read(file, on_order);
   }
+  flush();
+  if (error) {
+    std::cerr << "Failed to parse JSON: " << error << std::endl;
+    return 1;
+  }
+
   for (auto &item : securityIds) {
     std::cout << item << " | ";
   }
@@ -65,8 +179,11 @@ int main(int argc, char **argv) {
 
   if (argc == 3) {
     // second argument 
-    for (auto &item : securityIds) {
-      std::cout << cache.getMatchingSizeForSecurity(item) << " | ";
+    // all securities are matched in one call, by --threads threads
+    auto sizes = cache.getMatchingSizeForSecurities(
+        {securityIds.begin(), securityIds.end()}, threads);
+    for (auto size : sizes) {
+      std::cout << size << " | ";
     }
     std::cout << '\n';
   }
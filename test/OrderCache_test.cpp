@@ -1,8 +1,22 @@
 #include "../OrderCache.h"
+#include "../OrderJournal.h"
+#include "../OrderSnapshot.h"
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <csignal>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <set>
+#include <thread>
+
+#include <sys/resource.h>
+
 class OrderCache_test : public testing::Test {
 protected:
   OrderCache cache;
@@ -206,6 +220,39 @@ TEST_F(
   ASSERT_EQ(cache.lookAtList().back().orderId(), "3");
 }
 
+TEST_F(OrderCache_test,
+       cancel_orders_with_qty_in_big_bucket_Result_only_smaller_orders_left) {
+  // Arrange
+  for (unsigned int i = 0; i < 2000; ++i) {
+    cache.addOrder({std::to_string(i), "SecId1", i % 2 ? "Buy" : "Sell",
+                    (i * 7919) % 1000 + 1, "User1", "Company1"});
+  }
+  cache.addOrder({"Other", "SecId2", "Buy", 1000, "User1", "Company1"});
+  for (unsigned int i = 0; i < 2000; i += 3) {
+    cache.cancelOrder(std::to_string(i));
+  }
+
+  // Act
+  cache.cancelOrdersForSecIdWithMinimumQty("SecId1", 700);
+  cache.cancelOrdersForSecIdWithMinimumQty("SecId1", 900);
+  cache.addOrder({"Late", "SecId1", "Buy", 950, "User1", "Company1"});
+
+  // Assert
+  std::size_t expected{0};
+  for (unsigned int i = 0; i < 2000; ++i) {
+    expected += i % 3 && (i * 7919) % 1000 + 1 < 700;
+  }
+  auto orders = cache.getAllOrders();
+  ASSERT_EQ(orders.size(), expected + 2);
+  for (const auto &order : orders) {
+    if (order.securityId() == "SecId1" && order.orderId() != "Late") {
+      ASSERT_LT(order.qty(), 700);
+    }
+  }
+  cache.cancelOrdersForSecIdWithMinimumQty("SecId1", 1);
+  ASSERT_EQ(cache.getAllOrders().size(), 1);
+}
+
 TEST_F(OrderCache_test, try_to_obtain_all_data_Result_all_data_is_shown) {
   // Arrange
   Order order{"1", "1", "Buy", 200, "David", "Zero"};
@@ -388,3 +435,959 @@ TEST_F(OrderCache_test,
   ASSERT_EQ(quantity2, 600);
   ASSERT_EQ(quantity3, 0);
 }
+
+TEST_F(OrderCache_test,
+       get_matching_size_after_cancels_Result_totals_follow_the_cache) {
+  // Arrange
+  Order order1{"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"};
+  Order order2{"OrdId2", "SecId1", "Sell", 700, "User2", "CompanyB"};
+  Order order3{"OrdId3", "SecId1", "Sell", 2000, "User3", "CompanyC"};
+  Order order4{"OrdId4", "SecId1", "Buy", 400, "User2", "CompanyB"};
+  Order order5{"OrdId5", "SecId2", "Sell", 400, "User3", "CompanyC"};
+  cache.addOrder(order1);
+  cache.addOrder(order2);
+  cache.addOrder(order3);
+  cache.addOrder(order4);
+  cache.addOrder(order5);
+  auto before = cache.getMatchingSizeForSecurity("SecId1");
+
+  // Act
+  cache.cancelOrder("OrdId1");
+  auto after_cancel = cache.getMatchingSizeForSecurity("SecId1");
+  cache.cancelOrdersForSecIdWithMinimumQty("SecId1", 1500);
+  auto after_min_qty = cache.getMatchingSizeForSecurity("SecId1");
+  cache.cancelOrdersForUser("User2");
+  auto after_user = cache.getMatchingSizeForSecurity("SecId1");
+
+  // Assert
+  ASSERT_EQ(before, 1400);
+  ASSERT_EQ(after_cancel, 400);
+  ASSERT_EQ(after_min_qty, 0);
+  ASSERT_EQ(after_user, 0);
+  ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId2"), 0);
+}
+
+TEST_F(OrderCache_test,
+       add_side_in_mixed_case_Result_original_side_kept_and_orders_match) {
+  // Arrange
+  Order order1{"OrdId1", "SecId1", "bUY", 300, "User1", "CompanyA"};
+  Order order2{"OrdId2", "SecId1", "SELL", 200, "User2", "CompanyB"};
+  Order order3{"OrdId3", "SecId1", "Sel", 200, "User2", "CompanyB"};
+
+  // Act
+  cache.addOrder(order1);
+  cache.addOrder(order2);
+  cache.addOrder(order3);
+
+  // Assert
+  ASSERT_EQ(cache.lookAtList().size(), 2);
+  ASSERT_EQ(cache.lookAtList().front().side(), "bUY");
+  ASSERT_EQ(cache.lookAtList().back().side(), "SELL");
+  ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 200);
+}
+
+TEST_F(OrderCache_test, add_orders_in_batch_Result_status_for_every_order) {
+  // Arrange
+  std::vector<Order> orders{
+      {"OrdId1", "SecId1", "Buy", 300, "User1", "CompanyA"},
+      {"OrdId2", "SecId1", "Sell", 0, "User2", "CompanyB"},
+      {"OrdId3", "SecId1", "Sell", 200, "User2", "CompanyB"},
+      {"OrdId1", "SecId2", "Sell", 200, "User3", "CompanyC"},
+      {"OrdId4", "SecId2", "Bid", 200, "User3", "CompanyC"}};
+
+  // Act
+  auto statuses = cache.addOrders(orders);
+
+  // Assert
+  ASSERT_EQ(statuses,
+            (std::vector<AddStatus>{AddStatus::added, AddStatus::invalid,
+                                    AddStatus::added, AddStatus::duplicate,
+                                    AddStatus::invalid}));
+  ASSERT_EQ(cache.lookAtList().size(), 2);
+  ASSERT_EQ(cache.lookAtList().front().orderId(), "OrdId1");
+  ASSERT_EQ(cache.lookAtList().back().orderId(), "OrdId3");
+  ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 200);
+}
+
+TEST_F(OrderCache_test, move_orders_in_batch_Result_orders_are_in_cache) {
+  // Arrange
+  Order order{"1", "1", "Buy", 200, "David", "Zero"};
+  std::vector<Order> orders{order, {"2", "9", "Sell", 600, "Dede", "Flames"}};
+
+  // Act
+  auto statuses = cache.addOrders(std::move(orders));
+  auto duplicates = cache.addOrders(std::vector<Order>{order});
+
+  // Assert
+  ASSERT_EQ(statuses, std::vector<AddStatus>(2, AddStatus::added));
+  ASSERT_EQ(duplicates, std::vector<AddStatus>{AddStatus::duplicate});
+  ASSERT_EQ(cache.lookAtList().size(), 2);
+  ASSERT_EQ(cache.lookAtList().front().user(), "David");
+  ASSERT_EQ(cache.lookAtList().back().company(), "Flames");
+}
+
+TEST_F(OrderCache_test,
+       add_copied_and_moved_long_names_Result_copies_left_intact) {
+  // Arrange, names do not fit the small string buffer
+  const std::string prefix(32, 'x');
+  std::vector<Order> orders{
+      {prefix + "OrdId1", prefix + "SecId1", "Buy", 300, prefix + "User1",
+       prefix + "CompanyA"},
+      {prefix + "OrdId2", prefix + "SecId1", "Sell", 200, prefix + "User2",
+       prefix + "CompanyB"}};
+  Order moved{orders[1]};
+
+  // Act
+  auto statuses = cache.addOrders(orders);
+  cache.cancelOrder(prefix + "OrdId2");
+  cache.addOrder(std::move(moved));
+
+  // Assert
+  ASSERT_EQ(statuses, std::vector<AddStatus>(2, AddStatus::added));
+  ASSERT_EQ(orders[0].orderId(), prefix + "OrdId1");
+  ASSERT_EQ(orders[1].company(), prefix + "CompanyB");
+  ASSERT_EQ(cache.lookAtList().size(), 2);
+  ASSERT_EQ(cache.lookAtList().back().orderId(), prefix + "OrdId2");
+  ASSERT_EQ(cache.lookAtList().back().user(), prefix + "User2");
+  ASSERT_EQ(cache.getMatchingSizeForSecurity(prefix + "SecId1"), 200);
+}
+
+TEST_F(OrderCache_test,
+       cancel_user_orders_in_many_securities_Result_all_stripes_cleaned) {
+  // Arrange
+  for (int i = 0; i < 100; ++i) {
+    auto id = std::to_string(i);
+    cache.addOrder(Order{"OrdId" + id, "SecId" + id, i % 2 ? "Buy" : "Sell",
+                         100, i % 3 ? "User1" : "User2", "CompanyA"});
+  }
+
+  // Act
+  cache.cancelOrdersForUser("User1");
+
+  // Assert
+  auto orders = cache.getAllOrders();
+  ASSERT_EQ(orders.size(), 34);
+  ASSERT_EQ(cache.lookAtList().front().orderId(), "OrdId0");
+  ASSERT_EQ(cache.lookAtList().back().orderId(), "OrdId99");
+  for (std::size_t i = 0; i < orders.size(); ++i) {
+    ASSERT_EQ(orders[i].orderId(), "OrdId" + std::to_string(i * 3));
+  }
+}
+
+TEST(OrderCache_matching_test,
+     match_random_orders_Result_maximal_flow_and_not_less_than_greedy) {
+  // per company buy and sell totals of one security
+  using totals = std::vector<std::pair<long long, long long>>;
+
+  // the maximal flow from buys to sells of other companies, Edmonds-Karp on
+  // source, buys, sells and sink
+  auto max_flow = [](const totals &companies) {
+    auto n = companies.size();
+    auto source = 2 * n, sink = 2 * n + 1;
+    std::vector<std::vector<long long>> capacity(
+        2 * n + 2, std::vector<long long>(2 * n + 2, 0));
+    for (std::size_t c = 0; c < n; ++c) {
+      capacity[source][c] = companies[c].first;
+      capacity[n + c][sink] = companies[c].second;
+      for (std::size_t d = 0; d < n; ++d) {
+        capacity[c][n + d] = c == d ? 0 : 1LL << 40;
+      }
+    }
+    long long flow{0};
+    while (true) {
+      std::vector<std::size_t> parent(2 * n + 2, capacity.size());
+      std::vector<std::size_t> queue{source};
+      parent[source] = source;
+      for (std::size_t head = 0; head < queue.size(); ++head) {
+        for (std::size_t next = 0; next < capacity.size(); ++next) {
+          if (parent[next] == capacity.size() &&
+              capacity[queue[head]][next] > 0) {
+            parent[next] = queue[head];
+            queue.push_back(next);
+          }
+        }
+      }
+      if (parent[sink] == capacity.size()) {
+        return flow;
+      }
+      auto augment = std::numeric_limits<long long>::max();
+      for (auto node = sink; node != source; node = parent[node]) {
+        augment = std::min(augment, capacity[parent[node]][node]);
+      }
+      for (auto node = sink; node != source; node = parent[node]) {
+        capacity[parent[node]][node] -= augment;
+        capacity[node][parent[node]] += augment;
+      }
+      flow += augment;
+    }
+  };
+
+  // the greedy matching of company totals used before
+  auto greedy = [](const totals &companies) {
+    std::vector<std::pair<long long, std::size_t>> purchases, sales;
+    for (std::size_t c = 0; c < companies.size(); ++c) {
+      if (companies[c].first) {
+        purchases.emplace_back(companies[c].first, c);
+      }
+      if (companies[c].second) {
+        sales.emplace_back(companies[c].second, c);
+      }
+    }
+    auto descending = [](const auto &a, const auto &b) {
+      return a.first > b.first;
+    };
+    std::sort(purchases.begin(), purchases.end(), descending);
+    std::sort(sales.begin(), sales.end(), descending);
+    long long matched{0};
+    for (auto &[buy, buyer] : purchases) {
+      for (auto &[sell, seller] : sales) {
+        if (buyer != seller) {
+          auto match = std::min(buy, sell);
+          matched += match;
+          buy -= match;
+          sell -= match;
+        }
+      }
+    }
+    return matched;
+  };
+
+  std::mt19937 generator{11};
+  for (int round = 0; round < 500; ++round) {
+    // Arrange
+    OrderCache cache;
+    totals companies(1 + generator() % 6);
+    for (int order = 0; order < 12; ++order) {
+      auto company = generator() % companies.size();
+      auto qty = static_cast<unsigned int>(1 + generator() % 50);
+      bool buy = generator() % 2;
+      (buy ? companies[company].first : companies[company].second) += qty;
+      cache.addOrder({std::to_string(order), "SecId1", buy ? "Buy" : "Sell",
+                      qty, "User1", "Company" + std::to_string(company)});
+    }
+
+    // Act
+    auto matching = cache.getMatchingSizeForSecurity("SecId1");
+
+    // Assert
+    ASSERT_EQ(matching, max_flow(companies));
+    ASSERT_GE(matching, greedy(companies));
+  }
+}
+
+TEST_F(OrderCache_test,
+       repeat_matching_query_Result_memoised_until_security_changes) {
+  // Arrange
+  cache.addOrder({"OrdId1", "SecId1", "Buy", 1000, "User1", "CompanyA"});
+  cache.addOrder({"OrdId2", "SecId1", "Sell", 600, "User2", "CompanyB"});
+  cache.addOrder({"OrdId3", "SecId2", "Sell", 500, "User2", "CompanyB"});
+
+  // Act
+  auto first = cache.getMatchingSizeForSecurity("SecId1");
+  auto second = cache.getMatchingSizeForSecurity("SecId1");
+  auto memoised = cache.getMatchingCacheStats();
+  cache.addOrder({"OrdId4", "SecId1", "Sell", 300, "User2", "CompanyB"});
+  auto changed = cache.getMatchingSizeForSecurity("SecId1");
+  cache.cancelOrder("OrdId3");
+  auto unchanged = cache.getMatchingSizeForSecurity("SecId1");
+  auto stats = cache.getMatchingCacheStats();
+
+  // Assert
+  ASSERT_EQ(first, 600);
+  ASSERT_EQ(second, 600);
+  ASSERT_EQ(memoised.hits, 1);
+  ASSERT_EQ(memoised.misses, 1);
+  ASSERT_EQ(changed, 900);
+  ASSERT_EQ(unchanged, 900);
+  ASSERT_EQ(stats.hits, 2);
+  ASSERT_EQ(stats.misses, 2);
+}
+
+TEST_F(OrderCache_test,
+       get_matching_size_for_all_securities_Result_same_as_single_queries) {
+  // Arrange
+  OrderCache single; // not memoised by the bulk queries
+  for (int i = 0; i < 100; ++i) {
+    auto id = std::to_string(i);
+    auto security = "SecId" + std::to_string(i % 40);
+    for (auto *target : {&cache, &single}) {
+      target->addOrder({"Buy" + id, security, "Buy", 100u + i, "User1",
+                        "Company" + std::to_string(i % 3)});
+      target->addOrder({"Sell" + id, security, "Sell", 50u + i, "User2",
+                        "Company" + std::to_string(i % 5)});
+    }
+  }
+  std::vector<std::string> ids{"SecId7", "Unknown", "SecId3"};
+
+  // Act
+  auto all = cache.getMatchingSizeForAllSecurities(4);
+  auto some = cache.getMatchingSizeForSecurities(ids, 2);
+
+  // Assert
+  ASSERT_EQ(all.size(), 40);
+  ASSERT_TRUE(std::is_sorted(all.begin(), all.end()));
+  for (const auto &[securityId, size] : all) {
+    ASSERT_EQ(size, single.getMatchingSizeForSecurity(securityId));
+  }
+  ASSERT_EQ(some.size(), 3);
+  ASSERT_EQ(some[0], single.getMatchingSizeForSecurity("SecId7"));
+  ASSERT_EQ(some[1], 0);
+  ASSERT_EQ(some[2], single.getMatchingSizeForSecurity("SecId3"));
+}
+
+TEST_F(OrderCache_test, save_and_load_snapshot_Result_same_orders_restored) {
+  // Arrange
+  auto path = std::filesystem::temp_directory_path() / "OrderCache_test.bin";
+  cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 300, "User1", "CompanyA"});
+  cache.addOrder(Order{"OrdId2", "SecId1", "sell", 200, "User2", "CompanyB"});
+  cache.addOrder(Order{"OrdId3", "SecId2", "Sell", 100, "User1", ""});
+  cache.addOrder(Order{"OrdId4", "SecId2", "Buy", 500, "User3", "CompanyB"});
+  cache.cancelOrder("OrdId3");
+  OrderCache restored{3};
+  restored.addOrder(Order{"OrdId9", "SecId9", "Buy", 100, "User9", "A"});
+
+  // Act
+  auto saved = OrderSnapshot::save(cache, path.string());
+  auto loaded = OrderSnapshot::load(restored, path.string());
+  std::filesystem::remove(path);
+
+  // Assert
+  ASSERT_TRUE(saved);
+  ASSERT_TRUE(loaded);
+  auto expected = cache.getAllOrders();
+  auto orders = restored.getAllOrders();
+  ASSERT_EQ(orders.size(), expected.size());
+  for (std::size_t i = 0; i < orders.size(); ++i) {
+    ASSERT_EQ(orders[i].orderId(), expected[i].orderId());
+    ASSERT_EQ(orders[i].securityId(), expected[i].securityId());
+    ASSERT_EQ(orders[i].side(), expected[i].side());
+    ASSERT_EQ(orders[i].qty(), expected[i].qty());
+    ASSERT_EQ(orders[i].user(), expected[i].user());
+    ASSERT_EQ(orders[i].company(), expected[i].company());
+  }
+  ASSERT_EQ(restored.getMatchingSizeForSecurity("SecId1"), 200);
+  restored.cancelOrdersForUser("User1");
+  ASSERT_EQ(restored.lookAtList().size(), 2);
+  ASSERT_EQ(restored.lookAtList().front().orderId(), "OrdId2");
+}
+
+TEST_F(OrderCache_test,
+       load_snapshot_of_many_orders_Result_quantity_index_rebuilt) {
+  // Arrange, more orders of one security than a chunk of its index holds
+  auto path = std::filesystem::temp_directory_path() / "OrderCache_test.bin";
+  for (int i = 0; i < 1000; ++i) {
+    cache.addOrder(Order{"OrdId" + std::to_string(i), "SecId1",
+                         i % 2 ? "Buy" : "Sell",
+                         static_cast<unsigned int>(1 + i * 7919 % 1000),
+                         "User" + std::to_string(i % 7), "Company1"});
+  }
+  ASSERT_TRUE(OrderSnapshot::save(cache, path.string()));
+  OrderCache restored{16, OrderIdCodec{"OrdId"}};
+
+  // Act
+  auto loaded = OrderSnapshot::load(restored, path.string());
+  std::filesystem::remove(path);
+  restored.addOrder(Order{"Extra", "SecId1", "Buy", 600, "User1", "Company1"});
+  restored.cancelOrder("OrdId0"); // quantity 1
+  restored.cancelOrdersForSecIdWithMinimumQty("SecId1", 500);
+
+  // Assert, quantities 1 to 1000 were there once
+  ASSERT_TRUE(loaded);
+  auto orders = restored.getAllOrders();
+  ASSERT_EQ(orders.size(), 498);
+  for (const auto &order : orders) {
+    ASSERT_LT(order.qty(), 500);
+  }
+}
+
+TEST_F(OrderCache_test, load_broken_snapshot_Result_cache_not_changed) {
+  // Arrange
+  auto path = std::filesystem::temp_directory_path() / "OrderCache_test.bin";
+  cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 300, "User1", "CompanyA"});
+  ASSERT_TRUE(OrderSnapshot::save(cache, path.string()));
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(-1, std::ios::end);
+    file.put('?');
+  }
+
+  // Act
+  auto loaded = OrderSnapshot::load(cache, path.string());
+  auto missing = OrderSnapshot::load(cache, path.string() + ".missing");
+  std::filesystem::remove(path);
+
+  // Assert
+  ASSERT_FALSE(loaded);
+  ASSERT_FALSE(missing);
+  ASSERT_EQ(cache.lookAtList().size(), 1);
+  ASSERT_EQ(cache.lookAtList().front().orderId(), "OrdId1");
+}
+
+// counts the mutations it is told of
+class CountingOrderLog : public OrderLog {
+public:
+  void add(std::string_view, std::string_view, std::string_view, unsigned int,
+           std::string_view, std::string_view) override {
+    ++mutations;
+  }
+  void cancel(std::string_view) override { ++mutations; }
+  std::uint64_t position() const override { return mutations; }
+
+  std::uint64_t mutations{0};
+};
+
+TEST_F(OrderCache_test, load_snapshot_with_journal_Result_refused) {
+  // Arrange
+  auto path = std::filesystem::temp_directory_path() / "OrderCache_test.bin";
+  cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 300, "User1", "CompanyA"});
+  ASSERT_TRUE(OrderSnapshot::save(cache, path.string()));
+  OrderCache journaled;
+  journaled.addOrder(Order{"OrdId9", "SecId9", "Buy", 100, "User9", "A"});
+  CountingOrderLog journal;
+  journaled.setJournal(&journal);
+
+  // Act
+  auto loaded = OrderSnapshot::load(journaled, path.string());
+  std::filesystem::remove(path);
+
+  // Assert
+  ASSERT_FALSE(loaded);
+  ASSERT_EQ(journal.mutations, 0);
+  ASSERT_EQ(journaled.lookAtList().size(), 1);
+  ASSERT_EQ(journaled.lookAtList().front().orderId(), "OrdId9");
+}
+
+TEST_F(OrderCache_test,
+       replay_journal_after_snapshot_Result_same_orders_restored) {
+  // Arrange
+  auto directory = std::filesystem::temp_directory_path();
+  auto journalPath = (directory / "OrderCache_test.journal").string();
+  auto snapshotPath = (directory / "OrderCache_test.bin").string();
+  std::filesystem::remove(journalPath);
+  OrderJournal journal{std::chrono::microseconds(100)};
+  ASSERT_TRUE(journal.open(journalPath));
+  cache.setJournal(&journal);
+  cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 300, "User1", "CompanyA"});
+  cache.addOrder(Order{"OrdId2", "SecId1", "Sell", 200, "User2", "CompanyB"});
+  ASSERT_TRUE(OrderSnapshot::save(cache, snapshotPath));
+  cache.addOrder(Order{"OrdId3", "SecId2", "Sell", 100, "User1", "CompanyA"});
+  cache.addOrder(Order{"OrdId4", "SecId2", "Buy", 500, "User3", "CompanyB"});
+  cache.addOrder(Order{"OrdId5", "SecId1", "Buy", 400, "User2", "CompanyB"});
+  cache.addOrder(Order{"OrdId6", "SecId3", "Buy", 400, "User3", "CompanyC"});
+  cache.cancelOrder("OrdId1");
+  cache.cancelOrdersForUser("User2");
+  cache.cancelOrdersForSecIdWithMinimumQty("SecId2", 300);
+  ASSERT_TRUE(journal.sync());
+
+  // Act
+  OrderCache restored;
+  ASSERT_TRUE(OrderSnapshot::load(restored, snapshotPath));
+  MappedFile file;
+  OrderFileView snapshot;
+  ASSERT_TRUE(file.open(snapshotPath, 0));
+  ASSERT_TRUE(snapshot.open(file.data(), file.size()));
+  auto end = OrderJournalReader::read(
+      journalPath, snapshot.journal_position(),
+      [&restored](auto orderId, auto securityId, auto side, unsigned int qty,
+                  auto user, auto company) {
+        restored.addOrder(Order{std::string(orderId), std::string(securityId),
+                                std::string(side), qty, std::string(user),
+                                std::string(company)});
+      },
+      [&restored](auto orderId) {
+        restored.cancelOrder(std::string(orderId));
+      });
+  std::filesystem::remove(journalPath);
+  std::filesystem::remove(snapshotPath);
+
+  // Assert
+  ASSERT_EQ(end, journal.position());
+  auto orders = restored.getAllOrders();
+  ASSERT_EQ(orders.size(), 2);
+  ASSERT_EQ(orders[0].orderId(), "OrdId3");
+  ASSERT_EQ(orders[1].orderId(), "OrdId6");
+}
+
+TEST(OrderJournal_test, open_journal_with_broken_tail_Result_tail_cut_off) {
+  // Arrange
+  auto path =
+      (std::filesystem::temp_directory_path() / "OrderJournal_test.journal")
+          .string();
+  std::filesystem::remove(path);
+  std::uint64_t complete{0};
+  {
+    OrderJournal journal;
+    ASSERT_TRUE(journal.open(path));
+    journal.add("OrdId1", "SecId1", "Buy", 100, "User1", "CompanyA");
+    journal.cancel("OrdId1");
+    complete = journal.position();
+  }
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    file << "\x20partial";
+  }
+
+  // Act
+  OrderJournal journal;
+  auto opened = journal.open(path);
+  journal.cancel("OrdId2");
+  journal.close();
+  std::vector<std::string> cancels;
+  auto end = OrderJournalReader::read(
+      path, 0, [](auto...) {},
+      [&cancels](auto orderId) { cancels.emplace_back(orderId); });
+  std::filesystem::remove(path);
+
+  // Assert
+  ASSERT_TRUE(opened);
+  ASSERT_GT(end, complete);
+  ASSERT_EQ(cancels, (std::vector<std::string>{"OrdId1", "OrdId2"}));
+}
+
+TEST(OrderJournal_test, failed_write_Result_journal_stopped) {
+  // Arrange, a file size limit makes a write of the journal short
+  auto path =
+      (std::filesystem::temp_directory_path() / "OrderJournal_test.journal")
+          .string();
+  std::filesystem::remove(path);
+  OrderJournal journal;
+  ASSERT_TRUE(journal.open(path));
+  journal.add("OrdId1", "SecId1", "Buy", 100, "User1", "CompanyA");
+  ASSERT_TRUE(journal.sync());
+  auto complete = journal.position();
+  rlimit limit{}, saved{};
+  ::getrlimit(RLIMIT_FSIZE, &saved);
+  limit = saved;
+  limit.rlim_cur = complete + 10;
+  auto handler = std::signal(SIGXFSZ, SIG_IGN);
+  ::setrlimit(RLIMIT_FSIZE, &limit);
+
+  // Act
+  journal.add("OrdId2", "SecId1", "Buy", 100, "User1", "CompanyA");
+  auto synced = journal.sync();
+  ::setrlimit(RLIMIT_FSIZE, &saved);
+  std::signal(SIGXFSZ, handler);
+  journal.cancel("OrdId1");
+  auto later = journal.sync();
+  journal.close();
+  std::vector<std::string> ids;
+  auto end = OrderJournalReader::read(
+      path, 0, [&ids](auto orderId, auto...) { ids.emplace_back(orderId); },
+      [&ids](auto orderId) { ids.emplace_back(orderId); });
+  std::filesystem::remove(path);
+
+  // Assert
+  ASSERT_FALSE(synced);
+  ASSERT_FALSE(later);
+  ASSERT_TRUE(journal.failed());
+  ASSERT_EQ(journal.position(), complete);
+  ASSERT_EQ(end, complete);
+  ASSERT_EQ(ids, std::vector<std::string>{"OrdId1"});
+}
+
+TEST(OrderCache_stripes_test,
+     concurrent_writers_on_different_securities_Result_consistent_cache) {
+  // Arrange
+  OrderCache cache{4};
+  std::vector<std::thread> writers;
+
+  // Act
+  for (int writer = 0; writer < 4; ++writer) {
+    writers.emplace_back([&cache, writer] {
+      auto security = "SecId" + std::to_string(writer);
+      for (int i = 0; i < 1000; ++i) {
+        auto id = std::to_string(writer * 1000 + i);
+        cache.addOrder(Order{"OrdId" + id, security, i % 2 ? "Buy" : "Sell",
+                             10, "User" + std::to_string(i % 2),
+                             "Company" + std::to_string(i % 2)});
+        if (i % 4 == 3) {
+          cache.cancelOrder("OrdId" + id);
+        }
+      }
+    });
+  }
+  for (auto &writer : writers) {
+    writer.join();
+  }
+
+  // Assert
+  ASSERT_EQ(cache.lookAtList().size(), 3000);
+  for (int writer = 0; writer < 4; ++writer) {
+    ASSERT_EQ(
+        cache.getMatchingSizeForSecurity("SecId" + std::to_string(writer)),
+        2500);
+  }
+}
+
+TEST(OrderCache_stripes_test,
+     read_matching_while_orders_are_added_Result_published_totals_seen) {
+  // Arrange
+  OrderCache cache{4};
+  std::atomic<bool> done{false};
+  std::vector<std::thread> readers;
+  std::atomic<int> decreases{0};
+
+  // Act
+  for (int reader = 0; reader < 3; ++reader) {
+    readers.emplace_back([&] {
+      unsigned int last{0};
+      while (!done) {
+        auto size = cache.getMatchingSizeForSecurity("SecId1");
+        if (size < last) {
+          ++decreases;
+        }
+        last = size;
+      }
+    });
+  }
+  for (int i = 0; i < 1000; ++i) {
+    auto id = std::to_string(i);
+    cache.addOrders({{"Buy" + id, "SecId1", "Buy", 10, "User1", "CompanyA"},
+                     {"Sell" + id, "SecId1", "Sell", 10, "User2", "CompanyB"},
+                     {"Next" + id, "SecId2", "Sell", 10, "User2", "CompanyB"}});
+  }
+  done = true;
+  for (auto &reader : readers) {
+    reader.join();
+  }
+
+  // Assert
+  ASSERT_EQ(decreases, 0);
+  ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 10000);
+}
+
+TEST(OrderCache_stripes_test,
+     cancel_orders_of_many_companies_Result_published_totals_changed) {
+  // Arrange
+  OrderCache cache;
+  std::vector<Order> orders;
+  for (int i = 0; i < 20; ++i) {
+    auto id = std::to_string(i);
+    orders.emplace_back("Buy" + id, "SecId1", "Buy", 10, "User1",
+                        "Company" + id);
+  }
+  orders.emplace_back("Sell", "SecId1", "Sell", 150, "User2", "Seller");
+  cache.addOrders(std::move(orders));
+  auto before = cache.getMatchingSizeForSecurity("SecId1");
+
+  // Act
+  for (int i = 0; i < 10; ++i) {
+    cache.cancelOrder("Buy" + std::to_string(i));
+  }
+
+  // Assert
+  ASSERT_EQ(before, 150);
+  ASSERT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 100);
+}
+
+TEST(OrderCache_stripes_test, for_each_order_Result_orders_in_insertion_order) {
+  // Arrange
+  OrderCache cache{4};
+  for (int i = 0; i < 50; ++i) {
+    auto id = std::to_string(i);
+    cache.addOrder(Order{"OrdId" + id, "SecId" + std::to_string(i % 7), "Buy",
+                         10, "User1", "Company1"});
+  }
+  std::vector<std::string> ids;
+
+  // Act
+  cache.forEachOrder(
+      [&ids](const Order &order) { ids.push_back(order.orderId()); });
+
+  // Assert
+  std::vector<std::string> expected;
+  for (const auto &order : cache.getAllOrders()) {
+    expected.push_back(order.orderId());
+  }
+  ASSERT_EQ(ids.size(), 50);
+  ASSERT_EQ(ids, expected);
+}
+
+TEST(OrderCache_stripes_test,
+     pages_while_orders_change_Result_lasting_orders_visited_once) {
+  // with one stripe the next order of the cursor is the first one not
+  // visited in insertion order, so every page starts after a cancelled order
+  for (std::size_t stripes : {1u, 4u}) {
+    // Arrange
+    OrderCache cache{stripes};
+    for (int i = 0; i < 200; ++i) {
+      auto id = std::to_string(i);
+      cache.addOrder(Order{"OrdId" + id, "SecId" + std::to_string(i % 5),
+                           "Buy", 10, "User1", "Company1"});
+    }
+    std::map<std::string, int> visits;
+    std::set<std::string> changed;
+    OrderCache::orderCursor cursor;
+    int added{0};
+
+    // Act
+    while (!cursor.finished()) {
+      cache.forEachOrderPage(cursor, 3, [&visits](const Order &order) {
+        ++visits[order.orderId()];
+      });
+      // the first order not visited yet is cancelled and an order is added
+      for (const auto &order : cache.getAllOrders()) {
+        if (!visits.count(order.orderId())) {
+          changed.insert(order.orderId());
+          cache.cancelOrder(order.orderId());
+          break;
+        }
+      }
+      auto id = "Added" + std::to_string(added++);
+      changed.insert(id);
+      cache.addOrder(Order{id, "SecId" + std::to_string(added % 5), "Sell",
+                           10, "User2", "Company2"});
+    }
+
+    // Assert
+    for (int i = 0; i < 200; ++i) {
+      auto id = "OrdId" + std::to_string(i);
+      if (!changed.count(id)) {
+        ASSERT_EQ(visits[id], 1) << id;
+      }
+    }
+    for (const auto &[id, count] : visits) {
+      ASSERT_EQ(count, 1) << id;
+    }
+    ASSERT_EQ(cache.forEachOrderPage(cursor, 3, [](const Order &) {}), 0);
+  }
+}
+
+// keeps 4 bits of the hash only, so keys collide in the control bytes and
+// probe sequences get long
+struct colliding_hash {
+  std::size_t operator()(std::string_view key) const {
+    return std::hash<std::string_view>{}(key) & 0xF;
+  }
+};
+
+template <typename Hash> void compare_with_map() {
+  // Arrange
+  std::deque<std::string> keys;
+  for (int i = 0; i < 2000; ++i) {
+    keys.push_back("Key" + std::to_string(i));
+  }
+  FlatHashMap<std::string_view, int, Hash> table;
+  std::map<std::string_view, int> expected;
+  std::mt19937 generator{11};
+
+  // Act, inserts and erases leave tombstones behind and grow the table
+  for (int step = 0; step < 20000; ++step) {
+    std::string_view key = keys[generator() % keys.size()];
+    if (generator() % 3) {
+      auto [entry, added] = table.try_emplace(key, step);
+      ASSERT_EQ(added, expected.emplace(key, step).second) << key;
+      ASSERT_EQ(entry->second, expected[key]) << key;
+    } else {
+      ASSERT_EQ(table.erase(key), expected.erase(key) == 1) << key;
+    }
+  }
+
+  // Assert
+  ASSERT_EQ(table.size(), expected.size());
+  for (const auto &key : keys) {
+    auto *entry = table.find(std::string(key));
+    auto position = expected.find(key);
+    ASSERT_EQ(!entry, position == expected.end()) << key;
+    if (entry) {
+      ASSERT_EQ(entry->second, position->second) << key;
+    }
+  }
+  table.clear();
+  ASSERT_TRUE(table.empty());
+  ASSERT_FALSE(table.contains(keys.front()));
+}
+
+TEST(FlatHashMap_test, random_inserts_and_erases_Result_same_as_map) {
+  compare_with_map<std::hash<std::string_view>>();
+}
+
+TEST(FlatHashMap_test, colliding_hashes_Result_same_as_map) {
+  compare_with_map<colliding_hash>();
+}
+
+TEST(OrderIdCodec_test, canonical_prefixed_numbers_Result_recognised) {
+  // Arrange
+  OrderIdCodec codec{"OrdId"};
+
+  // Act & Assert
+  ASSERT_EQ(codec.number("OrdId0"), 0u);
+  ASSERT_EQ(codec.number("OrdId42"), 42u);
+  ASSERT_EQ(codec.number("OrdId999999999999999999"), 999999999999999999u);
+  ASSERT_EQ(codec.number("OrdId042"), std::nullopt);
+  ASSERT_EQ(codec.number("OrdId1000000000000000000"), std::nullopt);
+  ASSERT_EQ(codec.number("OrdId"), std::nullopt);
+  ASSERT_EQ(codec.number("OrdId4x"), std::nullopt);
+  ASSERT_EQ(codec.number("OrdId-4"), std::nullopt);
+  ASSERT_EQ(codec.number("42"), std::nullopt);
+  ASSERT_EQ(OrderIdCodec{""}.number("42"), 42u);
+  ASSERT_EQ(OrderIdCodec{}.number("42"), std::nullopt);
+}
+
+TEST(OrderIdCodec_test, numeric_and_text_ids_Result_kept_apart) {
+  // Arrange
+  OrderCache cache{16, OrderIdCodec{"OrdId"}};
+  std::vector<std::string> ids{"OrdId7", "OrdId07", "7", "OrdId",
+                               "OrdId123456789012345", "OrdIdX",
+                               "OrdId99999999999999999999"};
+
+  // Act
+  for (const auto &id : ids) {
+    cache.addOrder(Order{id, "SecId1", "Buy", 10, "User1", "Company1"});
+  }
+  auto duplicates = cache.addOrders(std::vector<Order>{
+      {"OrdId7", "SecId1", "Buy", 10, "User1", "Company1"},
+      {"OrdId07", "SecId1", "Buy", 10, "User1", "Company1"},
+      {"OrdId123456789012345", "SecId1", "Buy", 10, "User1", "Company1"}});
+  cache.cancelOrder("OrdId7");
+  cache.cancelOrder("OrdId123456789012345");
+
+  // Assert
+  ASSERT_EQ(duplicates, std::vector<AddStatus>(3, AddStatus::duplicate));
+  std::vector<std::string> left;
+  for (const auto &order : cache.getAllOrders()) {
+    left.push_back(order.orderId());
+  }
+  ASSERT_EQ(left, (std::vector<std::string>{"OrdId07", "7", "OrdId", "OrdIdX",
+                                            "OrdId99999999999999999999"}));
+}
+
+TEST(OrderIdCodec_test, sparse_number_later_covered_by_table_Result_found) {
+  // Arrange, with one shard the slot of a number is the number
+  OrderCache cache{1, OrderIdCodec{""}};
+  auto add = [&cache](int number) {
+    return cache.addOrders(std::vector<Order>{{std::to_string(number),
+                                               "SecId1", "Buy", 10, "User1",
+                                               "Company1"}})[0];
+  };
+  ASSERT_EQ(add(5000), AddStatus::added); // too far, kept in the hash map
+
+  // Act, the number table grows over slot 5000
+  for (int number = 0; number < 2000; ++number) {
+    ASSERT_EQ(add(number), AddStatus::added);
+  }
+  ASSERT_EQ(add(6000), AddStatus::added);
+  auto duplicate = add(5000);
+  cache.cancelOrder("5000");
+  auto again = add(5000);
+  cache.cancelOrder("1999");
+
+  // Assert
+  ASSERT_EQ(duplicate, AddStatus::duplicate);
+  ASSERT_EQ(again, AddStatus::added);
+  ASSERT_EQ(cache.getAllOrders().size(), 2001);
+  ASSERT_EQ(cache.lookAtList().back().orderId(), "5000");
+}
+
+class OrderIdCodec_cache_test : public testing::Test {
+protected:
+  // "OrdId<N>" ids are indexed by number
+  OrderCache cache{16, OrderIdCodec{"OrdId"}};
+  OrderCache text;
+};
+
+TEST_F(OrderIdCodec_cache_test, numeric_ids_Result_same_as_text_ids) {
+  // Arrange
+  std::vector<Order> orders;
+  for (int i = 0; i < 200; ++i) {
+    orders.push_back({"OrdId" + std::to_string(i % 150),
+                      "SecId" + std::to_string(i % 3), i % 2 ? "Sell" : "Buy",
+                      static_cast<unsigned>(100 + i),
+                      "User" + std::to_string(i % 7), "Company1"});
+  }
+
+  // Act
+  for (auto *target : {&cache, &text}) {
+    target->addOrders(orders);
+    target->cancelOrder("OrdId3");
+    target->cancelOrder("OrdId149");
+    target->cancelOrdersForUser("User2");
+    target->cancelOrdersForSecIdWithMinimumQty("SecId1", 200);
+    target->addOrder(Order{"OrdId3", "SecId0", "Sell", 50, "User9", "A"});
+  }
+
+  // Assert
+  auto expected = text.getAllOrders();
+  auto numeric = cache.getAllOrders();
+  ASSERT_EQ(numeric.size(), expected.size());
+  for (std::size_t i = 0; i < numeric.size(); ++i) {
+    ASSERT_EQ(numeric[i].orderId(), expected[i].orderId());
+    ASSERT_EQ(numeric[i].qty(), expected[i].qty());
+  }
+  for (auto security : {"SecId0", "SecId1", "SecId2"}) {
+    ASSERT_EQ(cache.getMatchingSizeForSecurity(security),
+              text.getMatchingSizeForSecurity(security));
+  }
+}
+
+TEST_F(OrderIdCodec_cache_test, load_snapshot_Result_numeric_ids_found) {
+  // Arrange
+  auto path = std::filesystem::temp_directory_path() / "OrderCache_test.bin";
+  cache.addOrder(Order{"OrdId1", "SecId1", "Buy", 300, "User1", "CompanyA"});
+  cache.addOrder(Order{"OrdId2", "SecId1", "Sell", 200, "User2", "CompanyB"});
+  cache.addOrder(Order{"OrdIdX", "SecId2", "Buy", 100, "User1", "CompanyA"});
+  OrderCache restored{3, OrderIdCodec{"OrdId"}};
+
+  // Act
+  OrderSnapshot::save(cache, path.string());
+  auto loaded = OrderSnapshot::load(restored, path.string());
+  std::filesystem::remove(path);
+  auto duplicate = restored.addOrders(std::vector<Order>{
+      {"OrdId1", "SecId1", "Buy", 10, "User1", "Company1"},
+      {"OrdIdX", "SecId1", "Buy", 10, "User1", "Company1"}});
+  restored.cancelOrder("OrdId2");
+
+  // Assert
+  ASSERT_TRUE(loaded);
+  ASSERT_EQ(duplicate, std::vector<AddStatus>(2, AddStatus::duplicate));
+  ASSERT_EQ(restored.lookAtList().size(), 2);
+  ASSERT_EQ(restored.getMatchingSizeForSecurity("SecId1"), 0);
+}
+
+TEST(WorkerPool_test, repeated_runs_Result_workers_reused) {
+  // Arrange
+  WorkerPool pool;
+  std::atomic<int> runs{0};
+  std::function<void()> task = [&runs] { ++runs; };
+
+  // Act
+  for (int call = 0; call < 100; ++call) {
+    pool.run(3, task);
+  }
+
+  // Assert, every call ran the task at least on the calling thread
+  ASSERT_EQ(pool.size(), 3u);
+  ASSERT_GE(runs.load(), 100);
+  ASSERT_LE(runs.load(), 400);
+}
+
+TEST(WorkerPool_test, concurrent_callers_Result_all_work_done) {
+  // Arrange
+  WorkerPool pool;
+  std::vector<std::atomic<int>> done(8);
+
+  // Act, callers share the workers, each one splits 1000 items
+  std::vector<std::thread> callers;
+  for (std::size_t caller = 0; caller < done.size(); ++caller) {
+    callers.emplace_back([&pool, &done, caller] {
+      for (int call = 0; call < 20; ++call) {
+        std::atomic<int> next{0};
+        std::function<void()> task = [&] {
+          while (next.fetch_add(1) < 1000) {
+            ++done[caller];
+          }
+        };
+        pool.run(2, task);
+      }
+    });
+  }
+  for (auto &caller : callers) {
+    caller.join();
+  }
+
+  // Assert
+  for (const auto &count : done) {
+    ASSERT_EQ(count.load(), 20000);
+  }
+  ASSERT_EQ(pool.size(), 2u);
+}
@@ -0,0 +1,462 @@
+#include "../MappedFile.h"
+#include "../OrderFile.h"
+#include "../OrderLoader.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class OrderLoader_test : public testing::Test {
+protected:
+  // orders of the JSON text read as a stream, in chunks smaller than a
+  // record, so the buffer of the reader has to grow
+  simdjson::error_code read(const std::string &json,
+                            JsonLayout layout = JsonLayout::array) {
+    std::istringstream input(json);
+    return JsonOrderReader{layout, 16}.read(
+        input, [this](Order &&order) { orders.push_back(std::move(order)); });
+  }
+
+  static std::string record(const std::string &id, const std::string &qty) {
+    return R"({"OrdId":")" + id +
+           R"(","SecId":"SecId1","TransactionType":"Buy","Amount":)" + qty +
+           R"(,"User":"User1","Company":"Company1"})";
+  }
+
+  void write(const std::string &contents) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+  }
+
+  void TearDown() override { std::filesystem::remove(path); }
+
+  static constexpr std::size_t padding = simdjson::SIMDJSON_PADDING;
+
+  std::vector<Order> orders;
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "OrderLoader_test.json";
+};
+
+TEST_F(OrderLoader_test, escaped_strings_Result_unescaped) {
+  // Arrange, braces and brackets in strings do not end a record
+  std::string json = R"([{"OrdId":"Ord\"1\\","SecId":"Secé}","Tran)"
+                     R"(sactionType":"Buy","Amount":"10","User":"U\/1]",)"
+                     R"("Company":"{Company\n1"}])";
+
+  // Act
+  auto error = read(json);
+
+  // Assert
+  ASSERT_EQ(error, simdjson::SUCCESS);
+  ASSERT_EQ(orders.size(), 1);
+  ASSERT_EQ(orders[0].orderId(), "Ord\"1\\");
+  ASSERT_EQ(orders[0].securityId(), "Sec\xc3\xa9}");
+  ASSERT_EQ(orders[0].user(), "U/1]");
+  ASSERT_EQ(orders[0].company(), "{Company\n1");
+  ASSERT_EQ(orders[0].qty(), 10);
+}
+
+TEST_F(OrderLoader_test, reordered_fields_Result_same_orders) {
+  // Arrange
+  std::string json = "[" + record("OrdId1", R"("5")") +
+                     R"(, {"Company":"Company2","User":"User2","Amount":7,)"
+                     R"("TransactionType":"Sell","SecId":"SecId2",)"
+                     R"("OrdId":"OrdId2"}])";
+
+  // Act
+  auto error = read(json);
+
+  // Assert
+  ASSERT_EQ(error, simdjson::SUCCESS);
+  ASSERT_EQ(orders.size(), 2);
+  ASSERT_EQ(orders[1].orderId(), "OrdId2");
+  ASSERT_EQ(orders[1].securityId(), "SecId2");
+  ASSERT_EQ(orders[1].side(), "Sell");
+  ASSERT_EQ(orders[1].qty(), 7);
+  ASSERT_EQ(orders[1].user(), "User2");
+  ASSERT_EQ(orders[1].company(), "Company2");
+}
+
+TEST_F(OrderLoader_test, empty_array_Result_no_orders) {
+  // Act
+  auto empty = read("[]");
+  auto spaced = read(" \n[ \r\n ]\n");
+
+  // Assert
+  ASSERT_EQ(empty, simdjson::SUCCESS);
+  ASSERT_EQ(spaced, simdjson::SUCCESS);
+  ASSERT_TRUE(orders.empty());
+}
+
+TEST_F(OrderLoader_test, trailing_garbage_Result_error) {
+  // Act
+  auto afterArray = read("[" + record("OrdId1", "1") + "] x");
+  auto secondArray = read("[" + record("OrdId2", "1") + "][]");
+  auto unclosed = read("[" + record("OrdId3", "1"));
+
+  // Assert
+  ASSERT_NE(afterArray, simdjson::SUCCESS);
+  ASSERT_NE(secondArray, simdjson::SUCCESS);
+  ASSERT_EQ(unclosed, simdjson::INCOMPLETE_ARRAY_OR_OBJECT);
+}
+
+TEST_F(OrderLoader_test, negative_amount_Result_error) {
+  // Act
+  auto text = read("[" + record("OrdId1", R"("-5")") + "]");
+  auto number = read("[" + record("OrdId2", "-5") + "]");
+  auto fraction = read("[" + record("OrdId3", R"("5.5")") + "]");
+
+  // Assert
+  ASSERT_EQ(text, simdjson::NUMBER_ERROR);
+  ASSERT_NE(number, simdjson::SUCCESS);
+  ASSERT_EQ(fraction, simdjson::NUMBER_ERROR);
+  ASSERT_TRUE(orders.empty());
+}
+
+TEST_F(OrderLoader_test, mapped_file_Result_contents_and_zero_padding) {
+  for (std::size_t size : {10, 4096}) {
+    // Arrange, a file of a whole page has its padding on a page of its own
+    write(std::string(size, 'x'));
+    MappedFile file;
+
+    // Act
+    auto opened = file.open(path.string(), padding);
+
+    // Assert
+    ASSERT_TRUE(opened);
+    ASSERT_EQ(file.size(), size);
+    ASSERT_EQ(std::string(file.data(), size), std::string(size, 'x'));
+    ASSERT_EQ(std::string(file.data() + size, padding),
+              std::string(padding, '\0'));
+  }
+}
+
+TEST_F(OrderLoader_test, mapped_empty_file_Result_only_padding) {
+  // Arrange
+  write("");
+  MappedFile file;
+
+  // Act
+  auto opened = file.open(path.string(), padding);
+
+  // Assert
+  ASSERT_TRUE(opened);
+  ASSERT_EQ(file.size(), 0);
+  ASSERT_EQ(file.data()[padding - 1], '\0');
+}
+
+TEST_F(OrderLoader_test, mapped_missing_file_or_directory_Result_not_open) {
+  // Arrange
+  MappedFile file;
+
+  // Act
+  auto missing = file.open(path.string(), padding);
+  auto directory =
+      file.open(std::filesystem::temp_directory_path(), padding);
+
+  // Assert
+  ASSERT_FALSE(missing);
+  ASSERT_FALSE(directory);
+  ASSERT_FALSE(file.is_open());
+}
+
+TEST_F(OrderLoader_test, mapped_file_moved_and_closed_Result_released) {
+  // Arrange
+  write("[]");
+  MappedFile file;
+  file.open(path.string(), padding);
+
+  // Act
+  MappedFile moved(std::move(file));
+
+  // Assert
+  ASSERT_FALSE(file.is_open());
+  ASSERT_TRUE(moved.is_open());
+  ASSERT_EQ(std::string(moved.data(), moved.size()), "[]");
+  moved.close();
+  ASSERT_FALSE(moved.is_open());
+  ASSERT_EQ(moved.size(), 0);
+}
+
+TEST_F(OrderLoader_test, mapped_file_Result_parsed_in_place) {
+  // Arrange
+  write("[" + record("OrdId1", "1") + "," + record("OrdId2", "2") + "]");
+  MappedFile file;
+  file.open(path.string(), padding);
+
+  // Act
+  auto error = JsonOrderReader{JsonLayout::array}.read(
+      file.data(), file.size(),
+      [this](Order &&order) { orders.push_back(std::move(order)); });
+
+  // Assert
+  ASSERT_EQ(error, simdjson::SUCCESS);
+  ASSERT_EQ(orders.size(), 2);
+  ASSERT_EQ(orders[1].orderId(), "OrdId2");
+  ASSERT_EQ(orders[1].qty(), 2);
+}
+
+TEST_F(OrderLoader_test, splitter_pieces_Result_record_ends) {
+  // Arrange, braces and quotes in strings are not structure
+  std::string first = R"({"a":"}\"{"})", second = R"({"b":[1,{}]})";
+  std::string json = "[ " + first + ", " + second + " ,{}]";
+  RecordSplitter splitter;
+  std::vector<std::size_t> ends;
+
+  // Act, a byte at a time, so every record is cut across pieces
+  for (std::size_t position = 0; position < json.size(); ++position) {
+    auto end = splitter.scan(json.data(), position, position + 1);
+    if (end != RecordSplitter::npos) {
+      ends.push_back(end);
+    }
+  }
+
+  // Assert
+  ASSERT_THAT(ends, testing::ElementsAre(
+                        2 + first.size(), 4 + first.size() + second.size(),
+                        json.size() - 1));
+  ASSERT_TRUE(splitter.finished());
+  ASSERT_FALSE(splitter.failed());
+}
+
+TEST_F(OrderLoader_test, splitter_not_array_of_objects_Result_failed) {
+  for (std::string json : {"[1]", "{}", "[{}]]", "x[]"}) {
+    // Arrange
+    RecordSplitter splitter;
+
+    // Act
+    splitter.scan(json.data(), 0, json.size());
+
+    // Assert
+    ASSERT_TRUE(splitter.failed()) << json;
+    ASSERT_FALSE(splitter.finished()) << json;
+  }
+}
+
+TEST_F(OrderLoader_test, parallel_Result_same_orders_as_sequential) {
+  // Arrange, chunks of a few records, duplicated ids included
+  std::string json = "[";
+  for (int index = 0; index < 500; ++index) {
+    json += (index ? "," : "") +
+            record("OrdId" + std::to_string(index % 450),
+                   std::to_string(index + 1));
+  }
+  simdjson::padded_string input(json + "]");
+  std::vector<Order> expected;
+  JsonOrderReader{JsonLayout::array}.read(
+      input.data(), input.size(),
+      [&expected](Order &&order) { expected.push_back(std::move(order)); });
+  std::size_t batches{0};
+
+  // Act
+  auto error = ParallelOrderLoader{4, JsonLayout::array, 256}.read(
+      input.data(), input.size(), [&](std::vector<Order> &&batch) {
+        ++batches;
+        for (auto &order : batch) {
+          orders.push_back(std::move(order));
+        }
+      });
+
+  // Assert
+  ASSERT_EQ(error, simdjson::SUCCESS);
+  ASSERT_GT(batches, 1);
+  ASSERT_EQ(orders.size(), expected.size());
+  for (std::size_t index = 0; index < orders.size(); ++index) {
+    ASSERT_EQ(orders[index].orderId(), expected[index].orderId());
+    ASSERT_EQ(orders[index].qty(), expected[index].qty());
+  }
+}
+
+TEST_F(OrderLoader_test, parallel_broken_input_Result_error) {
+  // Arrange
+  auto load = [](const std::string &json) {
+    simdjson::padded_string input(json);
+    return ParallelOrderLoader{2, JsonLayout::array, 64}.read(
+        input.data(), input.size(), [](std::vector<Order> &&) {});
+  };
+  std::string records;
+  for (int index = 0; index < 20; ++index) {
+    records += "," + record("OrdId" + std::to_string(index), "1");
+  }
+  records[0] = '[';
+
+  // Act
+  auto garbage = load(records + "] x");
+  auto unclosed = load(records);
+  auto negative = load(records + "," + record("OrdId", R"("-1")") + "]");
+
+  // Assert
+  ASSERT_EQ(garbage, simdjson::INCORRECT_TYPE);
+  ASSERT_EQ(unclosed, simdjson::INCOMPLETE_ARRAY_OR_OBJECT);
+  ASSERT_EQ(negative, simdjson::NUMBER_ERROR);
+}
+
+TEST_F(OrderLoader_test, ndjson_crlf_lines_Result_all_orders) {
+  // Arrange, blank lines and no line end after the last record
+  std::string json = record("OrdId1", "1") + "\r\n\r\n" +
+                     record("OrdId2", "2") + "\r\n" + record("OrdId3", "3");
+  simdjson::padded_string input(json);
+
+  // Act
+  auto streamed = read(json, JsonLayout::lines);
+  auto mapped = JsonOrderReader{JsonLayout::lines}.read(
+      input.data(), input.size(),
+      [this](Order &&order) { orders.push_back(std::move(order)); });
+
+  // Assert
+  ASSERT_EQ(streamed, simdjson::SUCCESS);
+  ASSERT_EQ(mapped, simdjson::SUCCESS);
+  ASSERT_EQ(orders.size(), 6);
+  ASSERT_EQ(orders[2].orderId(), "OrdId3");
+  ASSERT_EQ(orders[5].orderId(), "OrdId3");
+  ASSERT_EQ(orders[5].company(), "Company1");
+}
+
+TEST_F(OrderLoader_test, ndjson_broken_lines_Result_error) {
+  // Act
+  auto cut = read(record("OrdId1", "1") + "\n{\"OrdId\":", JsonLayout::lines);
+  auto array = read("[" + record("OrdId2", "1") + "]", JsonLayout::lines);
+
+  // Assert
+  ASSERT_EQ(cut, simdjson::INCOMPLETE_ARRAY_OR_OBJECT);
+  ASSERT_EQ(array, simdjson::INCORRECT_TYPE);
+  ASSERT_EQ(orders.size(), 1);
+}
+
+TEST_F(OrderLoader_test, follow_appended_lines_Result_read_when_complete) {
+  // Arrange, the second record is appended in two writes
+  auto second = record("OrdId2", "2") + "\n";
+  std::deque<std::string> appends{second.substr(0, 20), second.substr(20)};
+  std::stringstream input;
+  input << record("OrdId1", "1") << "\n";
+  std::vector<std::size_t> seen;
+
+  // Act
+  auto error = JsonOrderReader{JsonLayout::lines, 16}.follow(
+      input, [this](Order &&order) { orders.push_back(std::move(order)); },
+      [&] {
+        seen.push_back(orders.size());
+        if (appends.empty()) {
+          return false;
+        }
+        input.clear();
+        input << appends.front();
+        appends.pop_front();
+        return true;
+      });
+
+  // Assert
+  ASSERT_EQ(error, simdjson::SUCCESS);
+  ASSERT_THAT(seen, testing::ElementsAre(1, 1, 2));
+  ASSERT_EQ(orders[1].orderId(), "OrdId2");
+}
+
+class OrderFile_test : public testing::Test {
+protected:
+  // bytes of an order file of `count` orders on two securities
+  std::string save(std::size_t count) {
+    OrderFileWriter writer;
+    for (std::size_t index = 0; index < count; ++index) {
+      writer.add("OrdId" + std::to_string(index),
+                 index % 2 ? "SecId2" : "SecId1", index % 2 ? "Sell" : "Buy",
+                 static_cast<unsigned>(index + 1), "User1", "Company1");
+    }
+    writer.set_journal_position(42);
+    writer.save(path.string());
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), {}};
+  }
+
+  void TearDown() override { std::filesystem::remove(path); }
+
+  OrderFileView view;
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "OrderFile_test.bin";
+};
+
+TEST_F(OrderFile_test, saved_file_Result_same_orders) {
+  // Arrange
+  save(3);
+  MappedFile file;
+  file.open(path.string(), 0);
+  std::vector<std::string> orders;
+
+  // Act
+  auto opened = view.open(file.data(), file.size());
+  view.read([&orders](auto orderId, auto securityId, auto side, auto qty,
+                      auto user, auto company) {
+    orders.push_back(std::string(orderId) + " " + std::string(securityId) +
+                     " " + std::string(side) + " " + std::to_string(qty) +
+                     " " + std::string(user) + " " + std::string(company));
+  });
+
+  // Assert
+  ASSERT_TRUE(opened);
+  ASSERT_EQ(view.size(), 3);
+  ASSERT_EQ(view.journal_position(), 42);
+  ASSERT_EQ(view.table_size(OrderFileFormat::securities), 2);
+  ASSERT_EQ(view.table_size(OrderFileFormat::users), 1);
+  ASSERT_THAT(orders,
+              testing::ElementsAre("OrdId0 SecId1 Buy 1 User1 Company1",
+                                   "OrdId1 SecId2 Sell 2 User1 Company1",
+                                   "OrdId2 SecId1 Buy 3 User1 Company1"));
+}
+
+TEST_F(OrderFile_test, no_orders_Result_opened_empty) {
+  // Arrange
+  auto bytes = save(0);
+
+  // Act
+  auto opened = view.open(bytes.data(), bytes.size());
+
+  // Assert
+  ASSERT_TRUE(opened);
+  ASSERT_EQ(view.size(), 0);
+}
+
+TEST_F(OrderFile_test, bad_checksum_Result_not_opened) {
+  // Arrange, one bit of the last record changed
+  auto bytes = save(3);
+  bytes.back() ^= 1;
+
+  // Act
+  auto opened = view.open(bytes.data(), bytes.size());
+
+  // Assert
+  ASSERT_FALSE(opened);
+  ASSERT_FALSE(view.is_open());
+}
+
+TEST_F(OrderFile_test, truncated_file_Result_not_opened) {
+  // Arrange
+  auto bytes = save(3);
+
+  // Act
+  auto shorter = view.open(bytes.data(), bytes.size() - 1);
+  auto header = view.open(bytes.data(), sizeof(OrderFileFormat::header));
+  auto partial = view.open(bytes.data(), sizeof(OrderFileFormat::header) / 2);
+
+  // Assert
+  ASSERT_FALSE(shorter);
+  ASSERT_FALSE(header);
+  ASSERT_FALSE(partial);
+  ASSERT_FALSE(view.is_open());
+}
+
+TEST_F(OrderFile_test, wrong_magic_Result_not_opened) {
+  // Arrange, e.g. a JSON file
+  auto bytes = save(3);
+  bytes[0] = '[';
+
+  // Act
+  auto opened = view.open(bytes.data(), bytes.size());
+
+  // Assert
+  ASSERT_FALSE(opened);
+}
@@ -0,0 +1,60 @@
+#include "../MappedFile.h"
+#include "../OrderFile.h"
+#include "../OrderLoader.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Converts orders from a JSON file (the layout of test/data_generator.py, or
+// one order per line with --format=ndjson) to an order file.
+int main(int argc, char **argv) {
+  JsonLayout layout{JsonLayout::array};
+  std::string paths[2];
+  int positional{0};
+  for (int i = 1; i < argc; ++i) {
+    std::string arg{argv[i]};
+    if (arg == "--format=ndjson") {
+      layout = JsonLayout::lines;
+    } else if (positional < 2) {
+      paths[positional++] = arg;
+    } else {
+      positional = 3;
+    }
+  }
+  if (positional != 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--format=ndjson] input.json output.bin\n";
+    return 1;
+  }
+
+  OrderFileWriter writer;
+  auto on_order = [&writer](Order &&order) {
+    writer.add(order.orderId(), order.securityId(), order.side(), order.qty(),
+               order.user(), order.company());
+  };
+  JsonOrderReader reader{layout};
+  simdjson::error_code error;
+  MappedFile mapped;
+  if (mapped.open(paths[0], simdjson::SIMDJSON_PADDING)) {
+    error = reader.read(mapped.data(), mapped.size(), on_order);
+  } else {
+    std::ifstream file(paths[0], std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+      std::cerr << "Failed to open file: " << paths[0] << std::endl;
+      return 1;
+    }
+    error = reader.read(file, on_order);
+  }
+  if (error) {
+    std::cerr << "Failed to parse JSON: " << error << std::endl;
+    return 1;
+  }
+
+  if (!writer.save(paths[1])) {
+    std::cerr << "Failed to write file: " << paths[1] << std::endl;
+    return 1;
+  }
+  std::cout << writer.size() << " orders written to " << paths[1] << '\n';
+  return 0;
+}
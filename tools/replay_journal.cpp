@@ -0,0 +1,86 @@
+#include "../MappedFile.h"
+#include "../OrderCache.h"
+#include "../OrderFile.h"
+#include "../OrderJournal.h"
+#include "../OrderSnapshot.h"
+
+#include <iostream>
+#include <string>
+
+// Rebuilds the cache from a snapshot (optional) and the tail of the journal
+// written after the snapshot was taken, and saves the result as a new
+// snapshot (optional), which then points at the end of the journal.
+int main(int argc, char **argv) {
+  std::string journalPath, snapshotPath, savePath;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg{argv[i]};
+    if (arg.rfind("--snapshot=", 0) == 0) {
+      snapshotPath = arg.substr(11);
+    } else if (arg.rfind("--save=", 0) == 0) {
+      savePath = arg.substr(7);
+    } else if (journalPath.empty()) {
+      journalPath = arg;
+    } else {
+      journalPath.clear();
+      break;
+    }
+  }
+  if (journalPath.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " journal [--snapshot=snapshot.bin] [--save=snapshot.bin]\n";
+    return 1;
+  }
+
+  OrderCache cache;
+  std::uint64_t position{0};
+  if (!snapshotPath.empty()) {
+    MappedFile file;
+    OrderFileView snapshot;
+    // the file is mapped and validated once, the journal is attached to the
+    // cache only after the load
+    if (!file.open(snapshotPath, 0) ||
+        !snapshot.open(file.data(), file.size()) ||
+        !OrderSnapshot::load(cache, snapshot)) {
+      std::cerr << "Failed to load snapshot: " << snapshotPath << std::endl;
+      return 1;
+    }
+    position = snapshot.journal_position();
+  }
+
+  std::size_t records{0};
+  auto end = OrderJournalReader::read(
+      journalPath, position,
+      [&](std::string_view orderId, std::string_view securityId,
+          std::string_view side, unsigned int qty, std::string_view user,
+          std::string_view company) {
+        ++records;
+        cache.addOrder(Order{std::string(orderId), std::string(securityId),
+                             std::string(side), qty, std::string(user),
+                             std::string(company)});
+      },
+      [&](std::string_view orderId) {
+        ++records;
+        cache.cancelOrder(std::string(orderId));
+      });
+  if (!end) {
+    std::cerr << "Failed to read journal: " << journalPath << std::endl;
+    return 1;
+  }
+  std::cout << records << " records replayed, " << cache.lookAtList().size()
+            << " orders in cache\n";
+
+  if (!savePath.empty()) {
+    // the journal is opened to cut off a broken tail, so the new snapshot
+    // points just after the last replayed record
+    OrderJournal journal;
+    if (!journal.open(journalPath) || journal.position() != end) {
+      std::cerr << "Failed to open journal: " << journalPath << std::endl;
+      return 1;
+    }
+    cache.setJournal(&journal);
+    if (!OrderSnapshot::save(cache, savePath)) {
+      return 1;
+    }
+  }
+  return 0;
+}